@@ -0,0 +1,156 @@
+#!/usr/bin/env ruby
+#
+# Summarizes a heap dump written by snow_gc_dump_heap() or GC.dump(path):
+#
+#   heapsummary.rb snow.heap [number of rows]
+#
+# Shows the bytes per type, which roots retain the most, and the objects with the largest retained
+# size, i.e. the bytes that would be freed along with them. Retained sizes come from the dominator
+# tree of the object graph, with all roots under one virtual root. An object reachable from several
+# roots is attributed to the first of them, in the order globals, store keys, runtime roots, stacks.
+
+ROOT_ORDER = ["global", "store", "runtime", "stack"]
+
+path = ARGV[0] or abort "usage: #{$0} <heap dump> [rows]"
+rows = (ARGV[1] || 20).to_i
+
+# Node 0 is the virtual root; objects are numbered from 1 in the order they were dumped.
+index = {}
+addresses = [nil]
+types = [nil]
+sizes = [0]
+refs = [[]]
+roots = []
+
+File.open(path) do |f|
+  abort "#{path} is not a Snow heap dump" unless f.gets == "snow-heap 1\n"
+  f.each_line do |line|
+    fields = line.split
+    case fields[0]
+    when "object"
+      index[fields[1]] = types.size
+      addresses << fields[1]
+      types << fields[2]
+      sizes << fields[3].to_i
+      refs << fields[4..-1]
+    when "root"
+      roots << [fields[1], fields[2], fields[3]]
+    end
+  end
+end
+
+num_nodes = types.size
+refs.map! { |list| list.map { |address| index[address] }.compact }
+roots = roots.select { |kind, name, address| index[address] }
+roots = roots.sort_by.with_index { |(kind, name, address), i| [ROOT_ORDER.index(kind) || ROOT_ORDER.size, i] }
+refs[0] = roots.map { |kind, name, address| index[address] }.uniq
+
+# the first root to reach each object, by breadth-first search from one root after the other
+labels = Array.new(num_nodes)
+roots.each do |kind, name, address|
+  start = index[address]
+  next if labels[start]
+  label = "#{kind} #{name}".sub(/ -\z/, "")
+  labels[start] = label
+  queue = [start]
+  until queue.empty?
+    refs[queue.shift].each do |child|
+      next if labels[child]
+      labels[child] = label
+      queue << child
+    end
+  end
+end
+
+# postorder, by depth-first search from the virtual root
+postorder = Array.new(num_nodes)
+order = []
+visited = Array.new(num_nodes, false)
+visited[0] = true
+stack = [[0, 0]]
+until stack.empty?
+  node, i = stack.last
+  if i < refs[node].size
+    stack.last[1] += 1
+    child = refs[node][i]
+    next if visited[child]
+    visited[child] = true
+    stack << [child, 0]
+  else
+    stack.pop
+    postorder[node] = order.size
+    order << node
+  end
+end
+
+preds = Array.new(num_nodes) { [] }
+order.each { |node| refs[node].each { |child| preds[child] << node } }
+
+# immediate dominators, as in Cooper, Harvey and Kennedy's "A Simple, Fast Dominance Algorithm"
+idom = Array.new(num_nodes)
+idom[0] = 0
+changed = true
+while changed
+  changed = false
+  order.reverse_each do |node|
+    next if node == 0
+    new_idom = nil
+    preds[node].each do |pred|
+      next unless idom[pred]
+      if new_idom.nil?
+        new_idom = pred
+        next
+      end
+      a, b = pred, new_idom
+      while a != b
+        a = idom[a] while postorder[a] < postorder[b]
+        b = idom[b] while postorder[b] < postorder[a]
+      end
+      new_idom = a
+    end
+    if idom[node] != new_idom
+      idom[node] = new_idom
+      changed = true
+    end
+  end
+end
+
+# a node's dominator finishes after it, so this adds each subtree before its parent is read
+retained = sizes.dup
+order.each { |node| retained[idom[node]] += retained[node] unless node == 0 }
+
+total = sizes.sum
+reachable = order.sum { |node| sizes[node] }
+
+def bytes(n)
+  return "#{n} B" if n < 1024
+  return format("%.1f KiB", n / 1024.0) if n < 1024 * 1024
+  format("%.1f MiB", n / (1024.0 * 1024.0))
+end
+
+puts "#{num_nodes - 1} objects, #{bytes(total)}; #{bytes(reachable)} reachable, #{bytes(total - reachable)} garbage not yet collected"
+
+puts
+puts "Bytes per type:"
+by_type = Hash.new { |h, k| h[k] = [0, 0] }
+(1...num_nodes).each do |node|
+  by_type[types[node]][0] += 1
+  by_type[types[node]][1] += sizes[node]
+end
+by_type.sort_by { |type, (count, size)| -size }.first(rows).each do |type, (count, size)|
+  puts format("  %12s %10d  %s", bytes(size), count, type)
+end
+
+puts
+puts "Retained by root:"
+by_root = Hash.new(0)
+order.each { |node| by_root[labels[node]] += retained[node] if node != 0 && idom[node] == 0 }
+by_root.sort_by { |label, size| -size }.first(rows).each do |label, size|
+  puts format("  %12s  %s", bytes(size), label)
+end
+
+puts
+puts "Largest retained sizes:"
+(1...num_nodes).select { |node| idom[node] }.sort_by { |node| -retained[node] }.first(rows).each do |node|
+  puts format("  %12s  %s %s (%s), from %s", bytes(retained[node]), types[node], addresses[node], bytes(sizes[node]), labels[node])
+end
@@ -17,6 +17,7 @@ static inline void array_init(struct array_t* array)
 static inline void array_init_with_size(struct array_t* array, uintx size)
 {
 	array->data = size ? (VALUE*)snow_gc_alloc_blob(size * sizeof(VALUE)) : NULL;
+	snow_gc_write_barrier(&array->data, array->data);
 	array->size = 0;
 	array->alloc_size = size;
 }
@@ -30,10 +31,21 @@ static inline void array_grow(struct array_t* array, intx new_size)
 {
 	if (new_size > array->alloc_size)
 	{
-		VALUE* new_data = (VALUE*)snow_gc_alloc_blob(sizeof(VALUE) * new_size);
-		memcpy(new_data, array->data, sizeof(VALUE) * array->size);
+		// geometric growth, so that pushing doesn't copy the array every time
+		uintx capacity = array->alloc_size * 2;
+		if (capacity < new_size) capacity = new_size;
+		VALUE* new_data;
+		if (array->alloc_size)
+			new_data = (VALUE*)snow_gc_realloc_hint(array->data, sizeof(VALUE) * new_size, sizeof(VALUE) * capacity);
+		else
+		{
+			// the data is not ours, if there is any (see snow_ref_array)
+			new_data = (VALUE*)snow_gc_alloc_blob(sizeof(VALUE) * capacity);
+			if (array->size) memcpy(new_data, array->data, sizeof(VALUE) * array->size);
+		}
 		array->data = new_data;
-		array->alloc_size = new_size;
+		snow_gc_write_barrier(&array->data, new_data);
+		array->alloc_size = snow_gc_allocated_size(new_data) / sizeof(VALUE);
 	}
 	
 	if (new_size > array->size)
@@ -65,6 +77,7 @@ static inline VALUE array_set(struct array_t* array, intx idx, VALUE val)
 	if (idx < 0)
 		TRAP(); // index out of bounds
 	array->data[idx] = val;
+	snow_gc_write_barrier(array->data + idx, val);
 	return val;
 }
 
@@ -79,6 +92,7 @@ static inline VALUE array_erase(struct array_t* array, intx idx)
 	VALUE val = array->data[idx];
 	for (intx i = idx; i < array->size - 1; ++i) {
 		array->data[i] = array->data[i+1];
+		snow_gc_write_barrier(array->data + i, array->data[i]);
 	}
 	array->data[--array->size] = NULL;
 	return val;
@@ -11,6 +11,7 @@ void snow_init_class_class(SnClass** class_class)
 	snow_object_init((SnObject*)kl, NULL);
 	kl->name = snow_symbol("Class");
 	kl->instance_prototype = snow_create_object(NULL);
+	snow_gc_write_barrier(&kl->instance_prototype, kl->instance_prototype);
 	kl->base.prototype = kl->instance_prototype; // Class is the prototype of Class
 	snow_set_member(kl->instance_prototype, snow_symbol("class"), kl);
 	*class_class = kl;
@@ -22,6 +23,7 @@ SnClass* snow_create_class(const char* name)
 	snow_object_init((SnObject*)kl, snow_get_prototype(SN_CLASS_TYPE));
 	kl->name = snow_symbol(name);
 	kl->instance_prototype = snow_create_object(NULL); // NULL => Object is prototype
+	snow_gc_write_barrier(&kl->instance_prototype, kl->instance_prototype);
 	snow_set_member(kl->instance_prototype, snow_symbol("class"), kl);
 	return kl;
 }
@@ -126,6 +128,7 @@ SNOW_FUNC(class_new_class) {
 		ASSERT(is_object(superclass));
 		ASSERT_TYPE(superclass, SN_CLASS_TYPE);
 		new_class->instance_prototype->prototype = ((SnClass*)ARGS[0])->instance_prototype;
+		snow_gc_write_barrier(&new_class->instance_prototype->prototype, new_class->instance_prototype->prototype);
 	}
 	
 	if (yield) {
@@ -178,6 +181,7 @@ SnClass* _snow_create_class_wrap_struct(const char* name, const char* struct_nam
 	snow_object_init((SnObject*)kl, snow_get_prototype(SN_CLASS_TYPE));
 	kl->base.name = snow_symbol(name);
 	kl->base.instance_prototype = snow_create_object(NULL); // NULL => Object is prototype
+	snow_gc_write_barrier(&kl->base.instance_prototype, kl->base.instance_prototype);
 	snow_set_member(kl->base.instance_prototype, snow_symbol("class"), kl);
 	kl->struct_name = struct_name;
 	kl->struct_size = struct_size;
@@ -190,7 +194,7 @@ SnClass* _snow_create_class_wrap_struct(const char* name, const char* struct_nam
 SnObject* snow_create_wrap_object(SnClass* wrap_class)
 {
 	ASSERT_TYPE(wrap_class, SN_CLASS_TYPE);
-	ASSERT(snow_gc_allocated_size(wrap_class) == snow_gc_round(sizeof(SnWrapClass))); // hack to try to make sure that we're not in fact a regular class.
+	ASSERT(snow_gc_allocated_size(wrap_class) >= sizeof(SnWrapClass)); // hack to try to make sure that we're not in fact a regular class.
 	SnWrapClass* self = (SnWrapClass*)wrap_class;
 	ASSERT(self->base.instance_prototype);
 	
@@ -220,6 +224,6 @@ SnObject* snow_create_wrap_object(SnClass* wrap_class)
 
 void* _snow_unwrap_struct(SnObject* obj, uintx struct_size, const char* struct_name)
 {
-	ASSERT(snow_gc_allocated_size(obj) == snow_gc_round(sizeof(SnObject) + sizeof(SnGCFreeFunc) + struct_size));
+	ASSERT(snow_gc_allocated_size(obj) >= sizeof(SnObject) + sizeof(SnGCFreeFunc) + struct_size);
 	return ((byte*)obj) + sizeof(SnObject) + sizeof(SnGCFreeFunc);
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 HIDDEN void codegen_init(SnCodegen* cg, SnAstNode* root, SnCodegen* parent);
 HIDDEN void codegen_free(VALUE);
 HIDDEN void codegen_compile_root(SnCodegen* cg);
+HIDDEN void codegen_register_stack_map(SnCodegen* cg, const byte* compiled_code); // once the code is in place
 
 // setting information for accessing statically scoped variables
 HIDDEN bool codegen_variable_reference(SnCodegen* cg, SnSymbol variable_name, uint32_t* out_reference_index);
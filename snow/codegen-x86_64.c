@@ -14,15 +14,20 @@
 
 #include <stddef.h>
 
+#define MAX_MAPPED_TEMPORARIES 64 // temporaries past these are only scanned conservatively by the GC
+
 typedef struct SnCodegenX {
 	SnCodegen base;
 	SnLinkBuffer* returns;
 	intx num_temporaries;
 	SnArray* tmp_freelist;
+	uint64_t live_temporaries; // bit i is set while temporary i holds a reference the GC may move
+	SnLinkBuffer* call_sites; // SnGCCallSite entries for the stack map
+	uintx frame_size;
 } SnCodegenX;
 
 static void codegen_compile_node(SnCodegenX* cgx, SnAstNode*);
-static intx codegen_reserve_tmp(SnCodegenX* cgx);
+static intx codegen_reserve_tmp(SnCodegenX* cgx, bool movable);
 static void codegen_free_tmp(SnCodegenX* cgx, intx tmp);
 
 SnCodegen* snow_create_codegen(SnAstNode* root, SnCodegen* parent)
@@ -35,33 +40,52 @@ SnCodegen* snow_create_codegen(SnAstNode* root, SnCodegen* parent)
 	codegen->returns = NULL;
 	codegen->num_temporaries = 0;
 	codegen->tmp_freelist = NULL;
+	codegen->live_temporaries = 0;
+	codegen->call_sites = NULL;
+	codegen->frame_size = 0;
 	
 	return (SnCodegen*)codegen;
 }
 
-intx codegen_reserve_tmp(SnCodegenX* cgx)
+#define ASM(instr, ...) asm_##instr(cgx->base.buffer, __VA_ARGS__)
+#define ASM_S(instr) asm_##instr(cgx->base.buffer)
+#define ASM_LABEL ASM_S(label)
+#define RESERVE_TMP() codegen_reserve_tmp(cgx, true)
+#define RESERVE_PINNED_TMP() codegen_reserve_tmp(cgx, false) // for pointers the GC must not move
+#define FREE_TMP(tmp) codegen_free_tmp(cgx, tmp)
+#define TEMPORARY(tmp) ADDRESS(RBP, -(tmp+1) * sizeof(VALUE))
+#define CALL(func) codegen_compile_call_with_inlining(cgx, (void(*)())(func))
+
+intx codegen_reserve_tmp(SnCodegenX* cgx, bool movable)
 {
+	intx tmp;
 	if (cgx->tmp_freelist && snow_array_size(cgx->tmp_freelist) > 0)
-		return value_to_int(snow_array_pop(cgx->tmp_freelist));
+		tmp = value_to_int(snow_array_pop(cgx->tmp_freelist));
 	else
-		return cgx->num_temporaries++;
+		tmp = cgx->num_temporaries++;
+	
+	if (movable && tmp < MAX_MAPPED_TEMPORARIES)
+	{
+		// clear it, so the stack map never shows the GC what an earlier use left behind
+		ASM(xor, R11, R11);
+		ASM(mov, R11, TEMPORARY(tmp));
+		cgx->live_temporaries |= (uint64_t)1 << tmp;
+	}
+	return tmp;
 }
 
 void codegen_free_tmp(SnCodegenX* cgx, intx tmp)
 {
+	if (tmp < MAX_MAPPED_TEMPORARIES)
+		cgx->live_temporaries &= ~((uint64_t)1 << tmp);
 	if (!cgx->tmp_freelist)
+	{
 		cgx->tmp_freelist = snow_create_array_with_size(32);
+		snow_gc_write_barrier(&cgx->tmp_freelist, cgx->tmp_freelist);
+	}
 	snow_array_push(cgx->tmp_freelist, int_to_value(tmp));
 }
 
-#define ASM(instr, ...) asm_##instr(cgx->base.buffer, __VA_ARGS__)
-#define ASM_S(instr) asm_##instr(cgx->base.buffer)
-#define ASM_LABEL ASM_S(label)
-#define RESERVE_TMP() codegen_reserve_tmp(cgx)
-#define FREE_TMP(tmp) codegen_free_tmp(cgx, tmp)
-#define TEMPORARY(tmp) ADDRESS(RBP, -(tmp+1) * sizeof(VALUE))
-#define CALL(func) codegen_compile_call_with_inlining(cgx, (void(*)())(func))
-
 static void codegen_compile_call_with_inlining(SnCodegenX* cgx, void(*func)())
 {
 	if (func == (void(*)())snow_eval_truth)
@@ -122,9 +146,34 @@ static void codegen_compile_call_with_inlining(SnCodegenX* cgx, void(*func)())
 		// no inline version for this codegen
 		ASM(mov_id, IMMEDIATE(func), R10);
 		ASM(call, R10);
+		
+		if (cgx->live_temporaries)
+		{
+			// the return address identifies the call site when the GC walks the stack
+			SnGCCallSite site;
+			site.return_offset = snow_linkbuffer_size(cgx->base.buffer);
+			site.live_slots = cgx->live_temporaries;
+			if (!cgx->call_sites) {
+				cgx->call_sites = snow_create_linkbuffer(256);
+				snow_gc_write_barrier(&cgx->call_sites, cgx->call_sites);
+			}
+			snow_linkbuffer_push_data(cgx->call_sites, (byte*)&site, sizeof(site));
+		}
 	}
 }
 
+static void codegen_compile_safepoint_poll(SnCodegenX* cgx)
+{
+	// a thread running generated code that never allocates must still stop when a collection asks
+	Label no_safepoint = ASM_LABEL;
+	ASM(mov_id, IMMEDIATE(&_snow_gc_safepoint_requested), R11);
+	ASM(cmp_id, IMMEDIATE(0), ADDRESS(R11, 0));
+	LabelRef no_safepoint_jmp = ASM(j, CC_ZERO, &no_safepoint);
+	CALL(snow_gc_safepoint); // a call site like any other, so the live temporaries are found
+	ASM(bind, &no_safepoint);
+	ASM(link, &no_safepoint_jmp);
+}
+
 void codegen_compile_root(SnCodegen* cg)
 {
 	SnCodegenX* cgx = (SnCodegenX*)cg;
@@ -149,6 +198,7 @@ void codegen_compile_root(SnCodegen* cg)
 		SnArray* args_array = (SnArray*)args_seq->children[0];
 		ASSERT_TYPE(args_array, SN_ARRAY_TYPE);
 		cgx->base.result->argument_names = args_array;
+		snow_gc_write_barrier(&cgx->base.result->argument_names, args_array);
 		for (uintx i = 0; i < snow_array_size(args_array); ++i) {
 			VALUE vsym = snow_array_get(args_array, i);
 			ASSERT(is_symbol(vsym));
@@ -157,6 +207,8 @@ void codegen_compile_root(SnCodegen* cg)
 		}
 	}
 	
+	codegen_compile_safepoint_poll(cgx);
+	
 	// always clear rax before body, so empty functions will return nil.
 	ASM(xor, RAX, RAX);
 	
@@ -193,6 +245,7 @@ void codegen_compile_root(SnCodegen* cg)
 	stack_size += (stack_size & 0xf); // alignment
 	ASSERT(stack_size % 0x10 == 0);
 	snow_linkbuffer_modify(cgx->base.buffer, stack_size_offset, 4, (byte*)&stack_size);
+	cgx->frame_size = stack_size + 2 * sizeof(VALUE); // r13 and r14 are pushed below the temporaries
 	
 	
 	if (cgx->tmp_freelist && snow_array_size(cgx->tmp_freelist) != cgx->num_temporaries)
@@ -201,6 +254,18 @@ void codegen_compile_root(SnCodegen* cg)
 	}
 }
 
+void codegen_register_stack_map(SnCodegen* cg, const byte* compiled_code)
+{
+	SnCodegenX* cgx = (SnCodegenX*)cg;
+	if (!cgx->call_sites) return;
+	
+	uintx bytes = snow_linkbuffer_size(cgx->call_sites);
+	uintx num_sites = bytes / sizeof(SnGCCallSite);
+	SnGCCallSite sites[num_sites];
+	snow_linkbuffer_copy_data(cgx->call_sites, sites, bytes);
+	snow_gc_register_stack_map(compiled_code, snow_linkbuffer_size(cg->buffer), cgx->frame_size, sites, num_sites);
+}
+
 void codegen_compile_node(SnCodegenX* cgx, SnAstNode* node)
 {
 	ASSERT(node->base.type == SN_AST_TYPE);
@@ -265,6 +330,7 @@ void codegen_compile_node(SnCodegenX* cgx, SnAstNode* node)
 			LabelRef ref = ASM(jmp, NULL);
 			if (!cgx->returns) {
 				cgx->returns = snow_create_linkbuffer(16);
+				snow_gc_write_barrier(&cgx->returns, cgx->returns);
 			}
 			snow_linkbuffer_push_data(cgx->returns, (byte*)&ref.offset, sizeof(ref.offset));
 			
@@ -575,6 +641,7 @@ void codegen_compile_node(SnCodegenX* cgx, SnAstNode* node)
 			ASM(cmp, RAX, RCX);
 			LabelRef after_jmp = ASM(j, CC_ZERO, &after);
 			codegen_compile_node(cgx, (SnAstNode*)node->children[1]);
+			codegen_compile_safepoint_poll(cgx);
 			LabelRef cond_jmp = ASM(jmp, &cond);
 			ASM(bind, &after);
 			
@@ -592,7 +659,7 @@ void codegen_compile_node(SnCodegenX* cgx, SnAstNode* node)
 			LabelRef inner_ensure_jmp;
 			
 			intx return_value = RESERVE_TMP();
-			intx exception_handler = RESERVE_TMP();
+			intx exception_handler = RESERVE_PINNED_TMP(); // also referenced by the task
 			intx exception_to_propagate = RESERVE_TMP();
 			
 			ASM(mov_id, IMMEDIATE(0), TEMPORARY(exception_to_propagate));
@@ -620,7 +687,7 @@ void codegen_compile_node(SnCodegenX* cgx, SnAstNode* node)
 			if (catch_node) {
 				Label catch_catch = ASM_LABEL;
 				LabelRef catch_condition_failed_jmp;
-				intx catch_exception_handler = RESERVE_TMP();
+				intx catch_exception_handler = RESERVE_PINNED_TMP();
 				
 				CALL(snow_create_exception_handler);
 				ASM(mov, RAX, TEMPORARY(catch_exception_handler));
@@ -688,6 +755,10 @@ void codegen_compile_node(SnCodegenX* cgx, SnAstNode* node)
 			// `exception_handler->previous->exception = exception_handler->exception;`
 			ASM(mov_rev, R11, ADDRESS(RAX, offsetof(SnExceptionHandler, exception)));
 			ASM(mov, R11, ADDRESS(RDI, offsetof(SnExceptionHandler, exception)));
+			// `snow_gc_write_barrier(&exception_handler->previous->exception, exception_handler->exception);`
+			ASM(lea, RDI, ADDRESS(RDI, offsetof(SnExceptionHandler, exception)));
+			ASM(mov, R11, RSI);
+			CALL(snow_gc_write_barrier);
 			
 			CALL(snow_pop_exception_handler);
 			
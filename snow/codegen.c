@@ -3,6 +3,7 @@
 #include "snow/linkbuffer.h"
 #include "snow/intern.h"
 #include "snow/array-intern.h"
+#include "snow/str.h"
 #include <limits.h>
 #ifndef PAGESIZE
 #define PAGESIZE 4096
@@ -17,6 +18,7 @@ void codegen_init(SnCodegen* cg, SnAstNode* root, SnCodegen* parent)
 	cg->parent = parent;
 	cg->root = root;
 	cg->buffer = snow_create_linkbuffer(1024);
+	snow_gc_write_barrier(&cg->buffer, cg->buffer);
 }
 
 SnFunction* snow_codegen_compile(SnCodegen* cg)
@@ -27,7 +29,9 @@ SnFunction* snow_codegen_compile(SnCodegen* cg)
 
 SnFunctionDescription* snow_codegen_compile_description(SnCodegen* cg)
 {
+	DTRACE_PROBE(COMPILE_START(snow_string_cstr((SnString*)cg->root->children[0]), snow_string_cstr((SnString*)cg->root->children[1])));
 	cg->result = snow_create_function_description(NULL);
+	snow_gc_write_barrier(&cg->result, cg->result);
 	snow_function_description_define_local(cg->result, snow_symbol("it"));
 	
 	codegen_compile_root(cg);
@@ -42,11 +46,14 @@ SnFunctionDescription* snow_codegen_compile_description(SnCodegen* cg)
 	snow_linkbuffer_copy_data(cg->buffer, compiled_code, len);
 	int r = mprotect(compiled_code, len, PROT_EXEC);
 	ASSERT(r == 0);
+	codegen_register_stack_map(cg, compiled_code);
 	
 	CAST_DATA_TO_FUNCTION(cg->result->func, compiled_code);
 	
 	cg->result->ast = cg->root;
+	snow_gc_write_barrier(&cg->result->ast, cg->root);
 	
+	DTRACE_PROBE(COMPILE_END(snow_string_cstr((SnString*)cg->root->children[0]), snow_string_cstr((SnString*)cg->root->children[1]), len));
 	return cg->result;
 }
 
@@ -14,6 +14,7 @@ SnContext* snow_create_context(SnContext* static_parent)
 	ctx->self = NULL;
 	ctx->local_names = NULL;
 	ctx->locals = snow_create_array();
+	snow_gc_write_barrier(&ctx->locals, ctx->locals);
 	ctx->args = NULL;
 	return ctx;
 }
@@ -26,6 +27,7 @@ SnContext* snow_create_context_for_function(SnFunction* func)
 	ctx->self = NULL;
 	ctx->local_names = func->desc->defined_locals;
 	ctx->locals = snow_create_array_with_size(snow_array_size(ctx->local_names));
+	snow_gc_write_barrier(&ctx->locals, ctx->locals);
 	ctx->args = NULL;
 	return ctx;
 }
@@ -110,10 +112,14 @@ VALUE snow_context_set_local_local(SnContext* ctx, SnSymbol sym, VALUE val)
 	{
 		ASSERT(!ctx->function); // please use snow_create_context_for_function
 		ctx->local_names = snow_create_array();
+		snow_gc_write_barrier(&ctx->local_names, ctx->local_names);
 	}
 	
 	if (!ctx->locals)
+	{
 		ctx->locals = snow_create_array();
+		snow_gc_write_barrier(&ctx->locals, ctx->locals);
+	}
 	
 	intx idx = snow_array_find_or_add(ctx->local_names, vsym);
 	return snow_array_set(ctx->locals, idx, val);
@@ -32,6 +32,7 @@ void snow_continuation_init(SnContinuation* cc, SnFunctionPtr func, SnContext* c
 	cc->return_to = NULL;
 	cc->please_clean = NULL;
 	cc->context = context;
+	snow_gc_write_barrier(&cc->context, context);
 	cc->return_val = NULL;
 	cc->task_id = snow_get_current_task_id();
 }
@@ -65,6 +66,7 @@ VALUE snow_continuation_call(SnContinuation* cc, SnContinuation* return_to)
 	ASSERT(!cc->please_clean);
 	
 	cc->return_to = return_to;
+	snow_gc_write_barrier(&cc->return_to, return_to);
 	if (!snow_continuation_save_execution_state(return_to)) {
 		// resuming
 		snow_continuation_resume(cc);
@@ -91,6 +93,7 @@ void snow_continuation_yield(SnContinuation* cc, VALUE val)
 		return;
 	}
 	cc->return_val = val;
+	snow_gc_write_barrier(&cc->return_val, val);
 	ASSERT(cc->return_to->running);
 	ASSERT(!cc->return_to->please_clean);
 	snow_continuation_resume(cc->return_to);
@@ -101,11 +104,13 @@ void snow_continuation_return(SnContinuation* cc, VALUE val)
 	ASSERT(cc->interruptible);
 	cc->running = false;
 	cc->return_val = val;
+	snow_gc_write_barrier(&cc->return_val, val);
 	
 	// continuations cannot clean up themselves without messing up their
 	// stacks, so they need the calling continuation to do it for them.
 	ASSERT(!cc->return_to->please_clean);
 	cc->return_to->please_clean = cc;
+	snow_gc_write_barrier(&cc->return_to->please_clean, cc);
 	
 	ASSERT(cc->return_to->running);
 	snow_continuation_resume(cc->return_to);
@@ -13,9 +13,11 @@
 
 void snow_throw_exception(VALUE exception) 
 {
+	DTRACE_PROBE(EXCEPTION_THROW((uint64_t)exception));
 	SnExceptionHandler* handler = snow_get_current_task()->exception_handler;
 	if (handler != NULL) {
 		handler->exception = exception;
+		snow_gc_write_barrier(&handler->exception, exception);
 		snow_restore_execution_state(&handler->state);
 	} else {
 		snow_abort_current_task(exception);
@@ -10,6 +10,7 @@ SnFunctionDescription* snow_create_function_description(SnFunctionPtr func)
 	desc->func = func;
 	desc->name = snow_symbol("<unnamed>");
 	desc->defined_locals = snow_create_array();
+	snow_gc_write_barrier(&desc->defined_locals, desc->defined_locals);
 	desc->argument_names = NULL;
 	desc->num_variable_reference_descriptions = 0;
 	desc->variable_reference_descriptions = NULL;
@@ -91,6 +92,7 @@ void snow_function_declared_in_context(SnFunction* func, SnContext* context)
 	// about how to find the contexts.
 	
 	func->declaration_context = context;
+	snow_gc_write_barrier(&func->declaration_context, context);
 	
 	// TODO: This is terribly slow. Must be improved!
 	for (uint16_t i = 0; i < func->desc->num_variable_reference_descriptions; ++i)
@@ -98,6 +100,7 @@ void snow_function_declared_in_context(SnFunction* func, SnContext* context)
 		uint32_t level = func->desc->variable_reference_descriptions[i].context_level;
 		ASSERT(level != 0); // cannot deal with references to own context, since that context doesn't exist yet.
 		func->variable_references[i].context = context_at_level(context, level);
+		snow_gc_write_barrier(&func->variable_references[i].context, func->variable_references[i].context);
 		func->variable_references[i].variable_index = func->desc->variable_reference_descriptions[i].variable_index;
 	}
 }
@@ -132,7 +135,10 @@ static void function_setup_context(SnFunction* func, SnContext* context)
 	snow_context_set_local_local(context, value_to_symbol(sym_it), it ? it : SN_NIL);
 	
 	if (context->self == NULL && func->declaration_context)
+	{
 		context->self = func->declaration_context->self;
+		snow_gc_write_barrier(&context->self, context->self);
+	}
 	
 	// TODO: Optimize this
 	SnArray* arg_names = func->desc->argument_names;
@@ -154,6 +160,16 @@ VALUE snow_function_call(SnFunction* func, SnContext* context)
 {
 	function_setup_context(func, context);
 	
+	if (snow_gc_is_sampling())
+	{
+		// the allocation sampler keeps its own call stack, since contexts don't know their callers
+		const void* frame = __builtin_frame_address(0);
+		snow_gc_sampler_enter(func, frame);
+		VALUE ret = func->desc->func(context);
+		snow_gc_sampler_leave(frame);
+		return ret ? ret : SN_NIL;
+	}
+	
 	VALUE ret = func->desc->func(context);
 	return ret ? ret : SN_NIL;
 }
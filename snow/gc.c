@@ -3,51 +3,91 @@
 #include "snow/intern.h"
 #include "snow/continuation.h"
 #include "snow/task-intern.h"
+#include "snow/context.h"
+#include "snow/array.h"
 
 #include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <malloc/malloc.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/time.h>
 
 // only included for access to data structure layout in GC phases
 #include "snow/codegen.h"
 #include "snow/pointer.h"
 #include "snow/ast.h"
+#include "snow/weak.h"
 
 #define DEBUG_MALLOC 0 // set to 1 to override snow_malloc
 
+#ifndef GC_BEADS
+#ifdef DEBUG
+#define GC_BEADS 1 // surround allocations with magic beads, to catch overruns and stray pointers
+#else
+#define GC_BEADS 0 // compact allocations, with nothing but an 8-byte header
+#endif
+#endif
+
 volatile bool _snow_gc_is_collecting = false;
+volatile uintx _snow_gc_safepoint_requested = 0;
+volatile bool _snow_gc_is_sampling = false;
 
 HIDDEN SnArray** _snow_store_ptr(); // necessary for accessing global stuff
 
 struct SnGCObjectHead;
-struct SnGCObjectTail;
 struct SnGCAllocInfo;
-struct SnGCMetaInfo;
 struct SnGCHeap;
 struct SnGCHeapList;
+struct SnGCMarkStack;
 
 // internal functions
 typedef void(*SnGCAction)(VALUE* root_pointer, bool on_stack);
 static void gc_mark_root(VALUE* root, bool on_stack);
+static void gc_mark_root_parallel(VALUE* root, bool on_stack);
 static void gc_update_root(VALUE* root, bool on_stack);
 
-typedef void(*SnGCHeapAction)(struct SnGCHeap* heap, byte* object, struct SnGCAllocInfo* alloc_info, struct SnGCMetaInfo* meta_info, void* userdata);
+typedef void(*SnGCHeapAction)(struct SnGCHeap* heap, byte* object, struct SnGCAllocInfo* alloc_info, void* userdata);
 
 static void gc_minor();
+static void gc_sample_allocation(byte* object, size_t size);
+static void gc_decide_samples(bool all);
+static void gc_write_alloc_profile_at_exit();
 static void gc_major();
-static byte* gc_find_object_start(const struct SnGCHeap* heap, const byte* ptr, struct SnGCAllocInfo**, struct SnGCMetaInfo**);
+static void gc_major_sweep(bool compact);
+static void gc_concurrent_minor();
+static void gc_concurrent_mark_batch();
+static void gc_incremental_slice();
+static void gc_incremental_assist(size_t size);
+static void gc_concurrent_shade_promoted();
+static void gc_begin_concurrent_major();
+static void gc_finish_concurrent_major();
+static byte* gc_find_object_start(const struct SnGCHeap* heap, const byte* ptr, struct SnGCAllocInfo**);
 static struct SnGCHeap* gc_find_heap(const void* root);
 static bool gc_heap_contains(const struct SnGCHeap* heap, const void* root);
 static void gc_compute_checksum(struct SnGCAllocInfo* alloc_info);
 static bool gc_check_checksum(const struct SnGCAllocInfo* alloc_info);
 static bool gc_looks_like_allocation(const byte* ptr);
-static void gc_transplant(byte* object, struct SnGCAllocInfo* alloc_info, struct SnGCMetaInfo* meta_info, struct SnGCHeapList* transplant_to);
-static void gc_finalize_object(void* object, struct SnGCAllocInfo* alloc_info, struct SnGCMetaInfo* meta_info);
+static void gc_transplant(byte* object, struct SnGCAllocInfo* alloc_info, struct SnGCHeapList* transplant_to);
+static void gc_finalize_object(void* object, struct SnGCAllocInfo* alloc_info);
+static void gc_scan_object(byte* object, struct SnGCAllocInfo* alloc_info, SnGCAction action);
 static void gc_clear_flags();
 static void gc_with_each_object_in_heap_do(struct SnGCHeap* heap, SnGCHeapAction action, void* userdata);
+static void gc_mark_everything();
+static void gc_update_everything();
+static void gc_update_young();
+static void gc_clear_cards();
+static void gc_queue_dead_finalizable(struct SnGCMarkStack* finalizable, bool young);
+static void gc_forward_finalizable(struct SnGCMarkStack* finalizable, struct SnGCMarkStack* to);
+static void gc_mark_ephemerons();
+static void gc_clear_weak();
+static void gc_drop_dead_weak();
+static void gc_finish_sweeping();
+static void gc_start_sweeper();
 
 typedef enum SnGCFlag {
 	GC_NO_FLAGS      = 0,
@@ -55,6 +95,7 @@ typedef enum SnGCFlag {
 	GC_TRANSPLANTED  = 1 << 1,    // the object is no longer here
 	GC_UPDATED       = 1 << 2,    // the object has had its roots updated
 	GC_INDEFINITE    = 1 << 3,    // the object is referenced from the stack or another indefinite chunk of memory
+	GC_OVERFLOWED    = 1 << 4,    // the object's children could not be pushed on a full mark stack, and must be rescanned
 	GC_FLAGS_MAX
 } SnGCFlag;
 
@@ -76,44 +117,126 @@ typedef struct SnGCAllocInfo {
 	unsigned checksum     : 6; // sum of bits set in all the other fields
 } PACKED SnGCAllocInfo;
 
-typedef struct SnGCMetaInfo {
-	// sizeof(SnGCMetaInfo) must be == 8 bytes.
-	SnGCFreeFunc free_func;
-	#ifdef ARCH_IS_32_BIT
-	byte padding[4];
-	#endif
-} PACKED SnGCMetaInfo;
-
 #define MAGIC_BEAD_HEAD 0xbe4dbeedbaadb3ad
 #define MAGIC_BEAD_TAIL 0xb3adbaadbeedbe4d
 typedef uint64_t SnGCMagicBead;
 
+/*
+	Allocations are laid out as head, data, and (with GC_BEADS) tail. The data must be aligned
+	to SNOW_GC_ALIGNMENT, so without beads, every allocation begins 8 bytes into a granule, and
+	its size is rounded up to end 8 bytes into one too. Free functions are kept in a side table.
+*/
 typedef struct SnGCObjectHead {
 	SnGCAllocInfo alloc_info;
+	#if GC_BEADS
 	SnGCMagicBead bead;
+	#endif
 } SnGCObjectHead;
 
+#if GC_BEADS
 typedef struct SnGCObjectTail {
-	SnGCMetaInfo meta_info;
 	SnGCMagicBead bead;
 } SnGCObjectTail;
+#define GC_TAIL_SIZE sizeof(SnGCObjectTail)
+#else
+#define GC_TAIL_SIZE 0
+#endif
+
+#define GC_ALLOCATION_OVERHEAD (sizeof(SnGCObjectHead) + GC_TAIL_SIZE)
+#define GC_ALLOCATION_OFFSET ((SNOW_GC_ALIGNMENT - sizeof(SnGCObjectHead) % SNOW_GC_ALIGNMENT) % SNOW_GC_ALIGNMENT) // of the first allocation in a heap
 
 #define DEFAULT_HEAP_SIZE (1<<20)
+#define GC_MIN_ALLOCATION_SIZE (GC_ALLOCATION_OVERHEAD + SNOW_GC_ALIGNMENT - GC_ALLOCATION_OVERHEAD % SNOW_GC_ALIGNMENT)
 typedef byte SnGCFlags;
 static void* gc_alloc_chunk(size_t);
 static void gc_free_chunk(void* chunk, size_t);
+static void* gc_map_chunk(size_t);
+static void gc_unmap_chunk(void* chunk, size_t);
+static bool gc_reuse_chunk(struct SnGCHeap*, size_t);
+static bool gc_recycle_chunk(struct SnGCHeap*);
+static void gc_register_heap(struct SnGCHeap*);
+static void gc_unregister_heap(struct SnGCHeap*);
+static void gc_lazy_sweep_heap(struct SnGCHeap*, bool in_background);
 #include "snow/gcheap.h"
+#include "snow/gcreserve.h"
+#include "snow/gcmark.h"
+#include "snow/gcsample.h"
+#include "snow/gcfinalizers.h"
+#include "snow/gcsites.h"
 
 #define GC_NURSERY_SIZE 0x100000 // 1 MiB nurseries
 #define GC_ADULT_SIZE 0x800000 // 8 MiB adult heaps
+#define GC_SIZE_CLASS_HEAP_SIZE 0x40000 // 256 KiB size class heaps
+#define GC_FRAGMENTED_PERCENT 25 // size class heaps with fewer live slots than this are evacuated by major collections
 #define GC_BIG_ALLOCATION_SIZE_LIMIT 0x1000 // everything above 4K will go in the "biggies" allocation list
+#define GC_BIG_ALLOCATIONS_PER_MAJOR 0x4000000 // a major collection is forced after allocating 64 MiB of biggies
+#define GC_PRETENURED_PER_MAJOR 0x4000000 // or 64 MiB of objects of pretenured sites
+#define GC_NUM_CHUNK_POOLS 3 // nursery, adult, and size class chunks
+#define GC_CHUNK_POOL_HIGH_WATER 0x2000000 // idle chunks beyond 32 MiB per pool have their memory released
+#define GC_HOLE_SKIP_SIZE 0x100 // holes around pinned objects smaller than this are given up on by the first allocation that does not fit
+
+#define GC_MAX_MARK_THREADS 64
+#define GC_DEFAULT_MARK_STACK_LIMIT 0x100000 // entries; 8 MiB
+#define GC_CONCURRENT_MARK_BATCH 256 // objects marked by the concurrent marker per lock hold
+#define GC_CONCURRENT_MAX_MINOR_COLLECTIONS 100 // minor collections before the final pause is forced
+#define GC_DEFAULT_SLICE_BUDGET 2000 // microseconds per incremental slice
 
 typedef struct SnGCNursery {
 	SnGCHeap heap;
+	SnGCMarkStack barrier_buffer; // references stored by this thread while concurrent marking is running
+	SnGCSamplerStack calls; // the Snow functions being called, while sampling allocations
+	SnGCSiteId* sites; // of the objects in the heap, by object index; NULL until one has a site
 	struct SnGCNursery* next;
 	struct SnGCNursery* previous;
 } SnGCNursery;
 
+typedef struct SnGCFreeChunk {
+	// Written into the start of an idle chunk, which keeps its side tables while pooled.
+	struct SnGCFreeChunk* next;
+	SnGCFlags* flags;
+	SnGCBitmapWord* object_starts;
+	SnGCCard* cards;
+	bool resident; // false if the pages after this header were released with madvise
+} SnGCFreeChunk;
+
+typedef struct SnGCChunkPool {
+	SnGCFreeChunk* volatile head; // pushed during collection, popped with CAS by any thread
+	size_t chunk_size;
+	volatile uint32_t num_resident;
+} SnGCChunkPool;
+
+typedef struct SnGCStats {
+	uint32_t survived;
+	uint32_t freed;
+	uint32_t moved;
+	uint32_t indefinites;
+	uint32_t total;
+} SnGCStats;
+
+typedef struct SnGCWorker {
+	// Worker 0 is always the collecting thread, the rest are helper threads in the pool.
+	pthread_t thread;
+	uint32_t index;
+	uint32_t epoch;
+	SnGCMarkDeque deque;
+	SnGCStats stats; // merged into GC.stats when marking is done
+} SnGCWorker;
+
+typedef struct SnGCStackMap {
+	const byte* code;
+	uintx code_size;
+	uintx frame_size;
+	uintx num_sites;
+	SnGCCallSite sites[]; // sorted by return offset
+} SnGCStackMap;
+
+static __thread SnGCWorker* gc_current_worker = NULL;
+static __thread SnGCNursery* gc_current_nursery = NULL; // also in nursery_key, which finalizes it when the thread exits
+static __thread bool gc_running_finalizers = false;
+static __thread intx gc_sample_countdown = 0; // bytes to allocate before the next sample
+static __thread uint32_t gc_sample_seed = 0; // 0 until the first countdown is drawn
+static FILE* gc_dump_file = NULL; // only set while snow_gc_dump_heap has stopped the world
+
 struct {
 	pthread_mutex_t gc_lock;
 	
@@ -122,33 +245,173 @@ struct {
 	SnGCNursery* nursery_head;
 	
 	SnGCHeapList adults;
-	SnGCHeapList biggies;
+	SnGCHeapList biggies; // large heaps, one per allocation; swept in place by major collections
+	pthread_mutex_t biggies_lock;
+	uintx big_allocated_since_major; // bytes
 	SnGCHeapList unkillables; // nurseries that contained indefinite roots, so cannot be deleted yet :(
 	SnGCHeapList graveyard; // temporary list of dead heaps for use during collection
+	SnGCSizeClassSpace size_classes; // the old generation, unless options.copying_major is set
+	SnGCSiteTable sites; // allocation sites, for pretenuring
+	uintx pretenured_since_major; // bytes; under the sweeper lock, like everything allocated in the old generation
+	SnGCChunkPool chunk_pools[GC_NUM_CHUNK_POOLS]; // idle chunks of dead heaps, by size
+	
+	struct {
+		// Heaps that need_sweep are swept by this thread when the world is not stopped.
+		pthread_t thread;
+		bool started;
+		pthread_mutex_t lock; // held while sweeping, and throughout collections
+		pthread_cond_t wakeup;
+		uint32_t num_pending; // heaps that need_sweep
+		uint32_t epoch; // incremented by every collection, which may have changed the heap lists
+	} sweeper;
+	
+	struct {
+		/*
+			Objects with free functions, by generation. These are weak references until an object is
+			found dead; then it is resurrected, along with everything it references, and queued until
+			its free function has run after the pause.
+		*/
+		pthread_mutex_t lock;
+		SnGCFinalizerTable table; // the free functions
+		SnGCMarkStack young;
+		SnGCMarkStack old;
+		SnGCMarkStack queue; // roots
+		SnGCFreeFunc* queued_funcs; // of the objects in `queue', by index
+		uintx queued_funcs_capacity;
+	} finalizers;
+	
+	struct {
+		/*
+			Every WeakRef and WeakMap. Marking does not follow their references; instead, each
+			collection clears the ones to objects that it found dead, drops the weak objects that
+			died themselves, and points the rest at the objects that moved.
+		*/
+		pthread_mutex_t lock;
+		SnGCMarkStack objects;
+	} weak;
+	
+	struct {
+		/*
+			Between the initial pause and the final pause of a concurrent major collection, this
+			thread marks the old generation from `gray' while the mutators run. Collections in
+			between are minor ones, which shade what they promote. Incremental major collections
+			use the same state, but mark in slices instead of on the thread.
+		*/
+		pthread_t thread;
+		bool started;
+		pthread_mutex_t lock; // held while marking a batch, and throughout collections
+		pthread_cond_t wakeup;
+		volatile bool marking; // the write barrier records stored references
+		bool active; // between the initial and final pauses
+		bool done; // `gray' ran out; the next collection finishes the major collection
+		SnGCMarkStack gray; // swapped with GC.mark_stack by whoever is marking
+		SnGCMarkStack orphaned; // barrier buffers of threads that exited
+		uintx allocated; // bytes of big allocations since the last incremental slice
+	} concurrent;
+	
+	SnGCHeapIndex heap_index; // page -> heap, for every chunk
+	SnGCReservation reservation; // the address range that chunks are allocated from
+	
+	struct {
+		// Frame layouts of generated code, which let the stacks be scanned precisely where they are known.
+		pthread_mutex_t lock;
+		SnGCStackMap** maps; // sorted by code address
+		uintx size;
+		uintx capacity;
+	} stack_maps;
 	
 	uint16_t num_minor_collections_since_last_major_collection;
-	byte* lower_bound;
-	byte* upper_bound;
 	
+	SnGCStats stats;
+	SnGCMarkStack mark_stack;
+	SnGCMarkStack promoted; // objects transplanted out of nurseries during the current minor collection
 	struct {
-		uint32_t survived;
-		uint32_t freed;
-		uint32_t moved;
-		uint32_t indefinites;
-		uint32_t total;
-	} stats;
+		// While nurseries are swept, survivors are transplanted into the dead space of unkillable heaps first.
+		SnGCHeapListNode* node; // NULL when not sweeping nurseries
+		byte* next; // where to look for the next hole, or NULL for the start of the heap
+	} holes;
+	bool collecting_young; // a minor collection is marking nurseries only
+	bool collecting_old; // the concurrent marker is marking old heaps only
+	
+	struct {
+		bool generational; // SNOW_GC_GENERATIONAL; 0 makes minor collections trace the whole heap
+		bool copying_major; // SNOW_GC_MAJOR=copying; promote into adult heaps, and evacuate them all in major collections
+		bool lazy_sweep; // SNOW_GC_LAZY_SWEEP; 0 sweeps everything during major collections
+		bool concurrent_major; // SNOW_GC_CONCURRENT; mark major collections on a background thread
+		bool incremental_major; // SNOW_GC_INCREMENTAL; mark major collections in slices
+		uint32_t slice_budget; // SNOW_GC_SLICE_BUDGET; microseconds per incremental slice
+		uint32_t num_mark_threads; // SNOW_GC_THREADS; 1 means the serial mark path
+		uintx mark_stack_limit; // SNOW_GC_MARK_STACK_LIMIT; max entries in a mark stack or deque
+		uintx reservation_size; // SNOW_GC_RESERVE; bytes of address space for chunks, 0 for none
+		bool huge_pages; // SNOW_GC_HUGE_PAGES; ask for transparent huge pages in the reservation
+		bool pretenure; // SNOW_GC_PRETENURE; allocate the objects of sites that nearly always survive in the size class space
+	} options;
+	
+	struct {
+		SnGCWorker* workers;
+		uint32_t num_workers;
+		pthread_mutex_t lock;
+		pthread_cond_t wakeup;
+		pthread_cond_t done;
+		uint32_t epoch;
+		uint32_t num_done;
+		volatile intx num_active; // workers that may still produce mark work
+		volatile bool overflowed; // some worker hit the mark stack limit
+	} pool;
 	
 	struct {
 		uintx allocated_size;
 		uintx freed_size;
 		uintx total_mem_usage;
+		uint64_t num_slices; // incremental slices, and their durations in microseconds
+		uint64_t total_slice_time;
+		uint64_t last_slice_time;
+		uint64_t max_slice_time;
+		uintx num_chunks_allocated; // chunks that came from malloc, and were taken from the pools
+		uintx num_chunks_reused;
+		uintx num_chunks_released; // pooled chunks whose memory was given back with madvise
+		uintx pinned_size; // bytes of pinned objects in unkillable heaps, and of the pages released around them
+		uintx reclaimed_size;
 	} info;
+	
+	struct {
+		// What snow_gc_get_stats returns, published by each collection at the end of its pause.
+		pthread_mutex_t lock;
+		SnGCStatistics published;
+		
+		// The collection in progress. Time is charged to `phase' until the next phase begins.
+		SnGCPhaseTimes phase_time;
+		uint64_t* phase;
+		uint64_t phase_start;
+		uint64_t allocated; // bytes of big allocations, and of the nurseries once collecting
+		uint64_t pretenured; // bytes allocated in the old generation by pretenured sites; under the sweeper lock
+		uint64_t young_allocated;
+		uint64_t promoted;
+		uint64_t survived;
+		uint64_t total_young_allocated;
+	} statistics;
+	
+	struct {
+		// Samples are taken by the allocating threads, and decided on by collections.
+		pthread_mutex_t lock;
+		uintx interval; // SNOW_GC_SAMPLE_INTERVAL; bytes, or 0 when not sampling
+		const char* profile_path; // SNOW_GC_ALLOC_PROFILE; written at exit
+		SnGCSample* pending; // waiting for the next collection of their objects
+		uintx num_pending;
+		uintx pending_capacity;
+		SnGCSampleTable profile;
+	} sampler;
 } GC;
 
 static SnGCNursery* add_nursery() {
 	SnGCNursery* nursery = (SnGCNursery*)snow_malloc(sizeof(SnGCNursery));
 	gc_heap_init(&nursery->heap);
+	nursery->heap.young = true;
+	gc_mark_stack_init(&nursery->barrier_buffer, (uintx)-1);
+	nursery->calls.size = 0;
+	nursery->sites = NULL;
 	pthread_setspecific(GC.nursery_key, nursery);
+	gc_current_nursery = nursery;
 	nursery->previous = NULL;
 	
 	pthread_mutex_lock(&GC.nursery_lock);
@@ -163,7 +426,7 @@ static SnGCNursery* add_nursery() {
 }
 
 static inline SnGCHeap* gc_my_nursery() {
-	SnGCNursery* nursery = (SnGCNursery*)pthread_getspecific(GC.nursery_key);
+	SnGCNursery* nursery = gc_current_nursery;
 	if (!nursery) {
 		nursery = add_nursery();
 	}
@@ -173,11 +436,20 @@ static inline SnGCHeap* gc_my_nursery() {
 static void gc_finalize_nursery(void* _nursery) {
 	SnGCNursery* nursery = (SnGCNursery*)_nursery;
 	pthread_mutex_lock(&GC.nursery_lock);
-	gc_heap_list_push_heap(&GC.adults, &nursery->heap);
+	SnGCHeap* heap = &gc_heap_list_push_heap(&GC.adults, &nursery->heap)->heap;
+	// the objects may reference other nurseries, and no barrier has seen those stores
+	heap->young = false;
+	if (heap->start) gc_heap_dirty_range(heap, heap->start, heap->current);
 	if (nursery->previous) nursery->previous->next = nursery->next;
 	if (nursery->next) nursery->next->previous = nursery->previous;
 	if (GC.nursery_head == nursery) GC.nursery_head = nursery->next;
+	VALUE value;
+	while (gc_mark_stack_pop(&nursery->barrier_buffer, &value)) {
+		gc_mark_stack_push(&GC.concurrent.orphaned, value);
+	}
 	pthread_mutex_unlock(&GC.nursery_lock);
+	snow_free(nursery->barrier_buffer.items);
+	snow_free(nursery->sites);
 	snow_free(nursery);
 }
 
@@ -190,7 +462,82 @@ void snow_init_gc() {
 	pthread_mutex_init(&GC.nursery_lock, NULL);
 	gc_heap_list_init(&GC.adults);
 	gc_heap_list_init(&GC.biggies);
+	pthread_mutex_init(&GC.biggies_lock, NULL);
 	gc_heap_list_init(&GC.unkillables);
+	pthread_mutex_init(&GC.stack_maps.lock, NULL);
+	pthread_mutex_init(&GC.statistics.lock, NULL);
+	gc_size_class_space_init(&GC.size_classes);
+	GC.chunk_pools[0].chunk_size = GC_NURSERY_SIZE;
+	GC.chunk_pools[1].chunk_size = GC_ADULT_SIZE;
+	GC.chunk_pools[2].chunk_size = GC_SIZE_CLASS_HEAP_SIZE;
+	
+	const char* major = getenv("SNOW_GC_MAJOR");
+	GC.options.copying_major = major && strcmp(major, "copying") == 0;
+	
+	const char* lazy_sweep = getenv("SNOW_GC_LAZY_SWEEP");
+	GC.options.lazy_sweep = lazy_sweep ? atoi(lazy_sweep) != 0 : true;
+	pthread_mutex_init(&GC.sweeper.lock, NULL);
+	pthread_cond_init(&GC.sweeper.wakeup, NULL);
+	pthread_mutex_init(&GC.finalizers.lock, NULL);
+	gc_mark_stack_init(&GC.finalizers.young, (uintx)-1);
+	gc_mark_stack_init(&GC.finalizers.old, (uintx)-1);
+	gc_mark_stack_init(&GC.finalizers.queue, (uintx)-1);
+	pthread_mutex_init(&GC.weak.lock, NULL);
+	gc_mark_stack_init(&GC.weak.objects, (uintx)-1);
+	
+	const char* generational = getenv("SNOW_GC_GENERATIONAL");
+	GC.options.generational = generational ? atoi(generational) != 0 : true;
+	
+	// concurrent marking relies on minor collections leaving the old generation alone
+	const char* concurrent = getenv("SNOW_GC_CONCURRENT");
+	GC.options.concurrent_major = concurrent && atoi(concurrent) != 0 && GC.options.generational;
+	const char* incremental = getenv("SNOW_GC_INCREMENTAL");
+	GC.options.incremental_major = incremental && atoi(incremental) != 0 && GC.options.generational;
+	const char* slice_budget = getenv("SNOW_GC_SLICE_BUDGET");
+	GC.options.slice_budget = slice_budget ? strtoul(slice_budget, NULL, 0) : GC_DEFAULT_SLICE_BUDGET;
+	pthread_mutex_init(&GC.concurrent.lock, NULL);
+	pthread_cond_init(&GC.concurrent.wakeup, NULL);
+	gc_mark_stack_init(&GC.concurrent.orphaned, (uintx)-1);
+	
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const char* threads = getenv("SNOW_GC_THREADS");
+	long num_threads = threads ? atol(threads) : num_cpus;
+	if (num_threads < 1) num_threads = 1;
+	if (num_threads > GC_MAX_MARK_THREADS) num_threads = GC_MAX_MARK_THREADS;
+	GC.options.num_mark_threads = (uint32_t)num_threads;
+	
+	const char* stack_limit = getenv("SNOW_GC_MARK_STACK_LIMIT");
+	GC.options.mark_stack_limit = stack_limit ? strtoul(stack_limit, NULL, 0) : GC_DEFAULT_MARK_STACK_LIMIT;
+	if (GC.options.mark_stack_limit < 1) GC.options.mark_stack_limit = 1;
+	gc_mark_stack_init(&GC.mark_stack, GC.options.mark_stack_limit);
+	gc_mark_stack_init(&GC.concurrent.gray, GC.options.mark_stack_limit);
+	gc_mark_stack_init(&GC.promoted, (uintx)-1);
+	
+	const char* reserve = getenv("SNOW_GC_RESERVE");
+	GC.options.reservation_size = reserve ? strtoul(reserve, NULL, 0) : GC_RESERVATION_DEFAULT_SIZE;
+	const char* huge_pages = getenv("SNOW_GC_HUGE_PAGES");
+	GC.options.huge_pages = huge_pages ? atoi(huge_pages) != 0 : true;
+	if (GC.options.reservation_size) {
+		// a power of two, for the buddy allocator
+		uintx size = (uintx)1 << snow_highest_bit_index(GC.options.reservation_size);
+		gc_reservation_init(&GC.reservation, size, GC.options.huge_pages);
+	}
+	
+	const char* pretenure = getenv("SNOW_GC_PRETENURE");
+	// the adult heaps are copied by every major collection anyway
+	GC.options.pretenure = (pretenure ? atoi(pretenure) != 0 : true) && !GC.options.copying_major;
+	if (GC.options.pretenure) gc_site_table_init(&GC.sites);
+	
+	pthread_mutex_init(&GC.pool.lock, NULL);
+	pthread_cond_init(&GC.pool.wakeup, NULL);
+	pthread_cond_init(&GC.pool.done, NULL);
+	
+	pthread_mutex_init(&GC.sampler.lock, NULL);
+	GC.sampler.profile_path = getenv("SNOW_GC_ALLOC_PROFILE");
+	const char* sample_interval = getenv("SNOW_GC_SAMPLE_INTERVAL");
+	if (sample_interval) snow_gc_set_sample_interval(strtoul(sample_interval, NULL, 0));
+	else if (GC.sampler.profile_path) snow_gc_set_sample_interval(GC_SAMPLER_DEFAULT_INTERVAL);
+	if (GC.sampler.profile_path) atexit(gc_write_alloc_profile_at_exit);
 }
 
 static inline void gc_clear_statistics() {
@@ -201,182 +548,574 @@ static inline void gc_print_statistics(const char* phase) {
 	debug("GC: %s collection statistics: %u survived, %u freed, %u moved, %u indefinites, of %u objects.\n", phase, GC.stats.survived, GC.stats.freed, GC.stats.moved, GC.stats.indefinites, GC.stats.total);
 }
 
+static inline uint64_t gc_now_us() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static inline void gc_begin_phase(uint64_t* phase) {
+	// Charges the time since the last call to the phase in progress. NULL ends the last phase.
+	uint64_t now = gc_now_us();
+	if (GC.statistics.phase) *GC.statistics.phase += now - GC.statistics.phase_start;
+	GC.statistics.phase = phase;
+	GC.statistics.phase_start = now;
+}
+
+static uintx gc_heap_list_used_size(const SnGCHeapList* list) {
+	uintx size = 0;
+	for (SnGCHeapListNode* node = list->head; node != NULL; node = node->next) {
+		size += node->heap.current - node->heap.start;
+	}
+	return size;
+}
+
+static void gc_publish_statistics(bool major, uint64_t pause_time, uint64_t time_to_safepoint) {
+	// Called at the end of the pause, with the world still stopped.
+	SnGCStatistics* stats = &GC.statistics.published;
+	pthread_mutex_lock(&GC.statistics.lock);
+	++stats->num_collections;
+	if (major) ++stats->num_major_collections;
+	
+	stats->total_pause_time += pause_time;
+	stats->last_pause_time = pause_time;
+	if (pause_time > stats->max_pause_time) stats->max_pause_time = pause_time;
+	uint32_t bucket = 0;
+	while (bucket < SNOW_GC_PAUSE_HISTOGRAM_SIZE-1 && pause_time >= (64ULL << bucket)) ++bucket;
+	++stats->pause_histogram[bucket];
+	stats->total_time_to_safepoint += time_to_safepoint;
+	stats->last_time_to_safepoint = time_to_safepoint;
+	if (time_to_safepoint > stats->max_time_to_safepoint) stats->max_time_to_safepoint = time_to_safepoint;
+	// slices run on the collecting thread and on allocating ones, which are all stopped now
+	stats->num_slices = GC.info.num_slices;
+	stats->total_slice_time = GC.info.total_slice_time;
+	stats->last_slice_time = GC.info.last_slice_time;
+	stats->max_slice_time = GC.info.max_slice_time;
+	
+	stats->last_phase_time = GC.statistics.phase_time;
+	stats->total_phase_time.mark += GC.statistics.phase_time.mark;
+	stats->total_phase_time.sweep += GC.statistics.phase_time.sweep;
+	stats->total_phase_time.update += GC.statistics.phase_time.update;
+	
+	GC.statistics.total_young_allocated += GC.statistics.young_allocated;
+	stats->bytes_allocated += GC.statistics.allocated;
+	stats->bytes_promoted += GC.statistics.promoted;
+	stats->bytes_pretenured += GC.statistics.pretenured;
+	stats->bytes_survived += GC.statistics.survived;
+	stats->last_bytes_allocated = GC.statistics.allocated;
+	stats->last_bytes_survived = GC.statistics.survived;
+	stats->last_survival_rate = GC.statistics.young_allocated ? (double)GC.statistics.survived / GC.statistics.young_allocated : 0.0;
+	stats->survival_rate = GC.statistics.total_young_allocated ? (double)stats->bytes_survived / GC.statistics.total_young_allocated : 0.0;
+	
+	stats->nursery_size = GC.statistics.young_allocated; // they have all been emptied by now
+	stats->adult_size = gc_heap_list_used_size(&GC.adults);
+	stats->size_class_size = 0;
+	for (uint32_t i = 0; i < GC_NUM_SIZE_CLASSES; ++i) {
+		stats->size_class_size += gc_heap_list_used_size(&GC.size_classes.heaps[i]);
+	}
+	stats->big_size = gc_heap_list_used_size(&GC.biggies);
+	stats->unkillable_size = gc_heap_list_used_size(&GC.unkillables);
+	stats->pinned_size = GC.info.pinned_size;
+	stats->total_mem_usage = GC.info.total_mem_usage;
+	stats->num_pretenured_sites = 0;
+	for (uint32_t i = 1; GC.options.pretenure && i < GC.sites.num_sites; ++i) {
+		if (GC.sites.sites[i].pretenured) ++stats->num_pretenured_sites;
+	}
+	pthread_mutex_unlock(&GC.statistics.lock);
+	
+	memset(&GC.statistics.phase_time, 0, sizeof(GC.statistics.phase_time));
+	GC.statistics.allocated = GC.statistics.young_allocated = GC.statistics.promoted = GC.statistics.survived = GC.statistics.pretenured = 0;
+}
+
+void snow_gc_get_stats(SnGCStatistics* stats) {
+	pthread_mutex_lock(&GC.statistics.lock);
+	memcpy(stats, &GC.statistics.published, sizeof(SnGCStatistics));
+	pthread_mutex_unlock(&GC.statistics.lock);
+}
+
+uintx snow_gc_get_pretenured_sites(SnGCAllocationSite* sites, uintx max) {
+	// sites are only decided on while the world is stopped, and only ever added to the table
+	uintx n = 0;
+	for (uint32_t i = 1; GC.options.pretenure && i < GC.sites.num_sites; ++i) {
+		const SnGCSite* site = &GC.sites.sites[i];
+		if (!site->pretenured) continue;
+		if (n < max) {
+			sites[n].address = site->address;
+			sites[n].num_tenured = site->num_tenured;
+		}
+		++n;
+	}
+	return n;
+}
+
 static inline void* gc_alloc_chunk(size_t size) {
-	// allocate while updating bounds
-	byte* ptr = (byte*)snow_malloc(size);
-	if (ptr < GC.lower_bound || !GC.lower_bound)
-		GC.lower_bound = ptr;
-	if ((ptr + size) > GC.upper_bound)
-		GC.upper_bound = ptr + size;
-	GC.info.allocated_size += size;
-	GC.info.total_mem_usage += size;
+	// chunks are page-aligned, so no two heaps ever share a page in the heap index
+	byte* ptr = (byte*)gc_reservation_alloc(&GC.reservation, size);
+	if (!ptr) {
+		ptr = (byte*)snow_malloc_aligned(size, GC_PAGE_SIZE);
+		__sync_fetch_and_add(&GC.reservation.num_outside, 1);
+	}
+	// nurseries are refilled by their threads without any locks
+	__sync_fetch_and_add(&GC.info.num_chunks_allocated, 1);
+	__sync_fetch_and_add(&GC.info.allocated_size, size);
+	__sync_fetch_and_add(&GC.info.total_mem_usage, size);
 	return ptr;
 }
 
 static inline void gc_free_chunk(void* chunk, size_t size) {
-	byte* ptr = (byte*)chunk;
-	if (GC.lower_bound == ptr)
-		GC.lower_bound = ptr + size; // guess a new lower bound
-	if ((ptr + size) == GC.upper_bound)
-		GC.upper_bound = ptr;
-	GC.info.freed_size += size;
-	GC.info.total_mem_usage -= size;
-	snow_free(chunk);
+	__sync_fetch_and_add(&GC.info.freed_size, size);
+	__sync_fetch_and_sub(&GC.info.total_mem_usage, size);
+	if (gc_reservation_contains(&GC.reservation, chunk)) {
+		madvise(chunk, size, MADV_DONTNEED);
+		gc_reservation_free(&GC.reservation, chunk, size);
+	} else if (chunk) {
+		// heaps that never got a chunk are finalized too
+		snow_free(chunk);
+		__sync_fetch_and_sub(&GC.reservation.num_outside, 1);
+	}
+}
+
+static inline void* gc_map_chunk(size_t size) {
+	// large chunks return their memory to the OS as soon as they are freed
+	void* ptr = gc_reservation_alloc(&GC.reservation, size);
+	if (!ptr) {
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+		ASSERT(ptr != MAP_FAILED); // out of memory!
+		__sync_fetch_and_add(&GC.reservation.num_outside, 1);
+	}
+	__sync_fetch_and_add(&GC.info.allocated_size, size);
+	__sync_fetch_and_add(&GC.info.total_mem_usage, size);
+	return ptr;
+}
+
+static inline void gc_unmap_chunk(void* chunk, size_t size) {
+	__sync_fetch_and_add(&GC.info.freed_size, size);
+	__sync_fetch_and_sub(&GC.info.total_mem_usage, size);
+	if (gc_reservation_contains(&GC.reservation, chunk)) {
+		madvise(chunk, size, MADV_DONTNEED);
+		gc_reservation_free(&GC.reservation, chunk, size);
+	} else {
+		munmap(chunk, size);
+		__sync_fetch_and_sub(&GC.reservation.num_outside, 1);
+	}
+}
+
+static void gc_register_heap(SnGCHeap* heap) {
+	if (heap->start) gc_heap_index_set(&GC.heap_index, heap->start, heap->end, heap);
+}
+
+static void gc_unregister_heap(SnGCHeap* heap) {
+	if (heap->start) gc_heap_index_set(&GC.heap_index, heap->start, heap->end, NULL);
 }
 
 static inline size_t gc_calculate_total_size(size_t size) {
-	size_t extra_stuff = sizeof(SnGCObjectHead) + sizeof(SnGCObjectTail);
-	return size + extra_stuff;
+	return size + GC_ALLOCATION_OVERHEAD;
 }
 
-static inline byte* gc_init_allocation(byte* allocated_memory, size_t rounded_size, SnGCAllocType alloc_type, uint32_t object_index, SnGCFreeFunc free_func)
-{
-	byte* ptr = allocated_memory;
-	
-	SnGCObjectHead* head = (SnGCObjectHead*)ptr;
-	ptr += sizeof(SnGCObjectHead);
-	byte* data = ptr;
-	ptr += rounded_size;
-	SnGCObjectTail* tail = (SnGCObjectTail*)ptr;
-	ptr += sizeof(SnGCObjectTail);
-	
+static inline size_t gc_round_size(size_t size) {
+	// the size of the data of an allocation of `size' bytes, which is padded up to the alignment of the next one
+	return snow_gc_round(size + GC_ALLOCATION_OVERHEAD) - GC_ALLOCATION_OVERHEAD;
+}
+
+static inline void gc_init_beads(SnGCObjectHead* head, byte* end) {
+	#if GC_BEADS
 	head->bead = MAGIC_BEAD_HEAD;
-	tail->bead = MAGIC_BEAD_TAIL;
+	((SnGCObjectTail*)(end - sizeof(SnGCObjectTail)))->bead = MAGIC_BEAD_TAIL;
+	#endif
+}
+
+static inline byte* gc_init_allocation(SnGCHeap* heap, byte* allocated_memory, size_t rounded_size, SnGCAllocType alloc_type, uint32_t object_index)
+{
+	gc_heap_set_object_start(heap, allocated_memory);
 	
-	SnGCAllocInfo* alloc_info = &head->alloc_info;
-	SnGCMetaInfo* meta_info = &tail->meta_info;
+	SnGCObjectHead* head = (SnGCObjectHead*)allocated_memory;
+	byte* data = allocated_memory + sizeof(SnGCObjectHead);
+	gc_init_beads(head, allocated_memory + gc_calculate_total_size(rounded_size));
 	
 	// init alloc_info, and compute checksum
+	SnGCAllocInfo* alloc_info = &head->alloc_info;
 	alloc_info->size = rounded_size;
 	alloc_info->object_index = object_index;
 	alloc_info->alloc_type = alloc_type;
 	gc_compute_checksum(alloc_info);
 	
-	// init meta_info
-	meta_info->free_func = free_func;
-	
 	return data;
 }
 
-static inline void* gc_alloc(size_t size, SnGCAllocType alloc_type) {
+static inline SnGCChunkPool* gc_chunk_pool(size_t chunk_size) {
+	for (int i = 0; i < GC_NUM_CHUNK_POOLS; ++i) {
+		if (GC.chunk_pools[i].chunk_size == chunk_size) return &GC.chunk_pools[i];
+	}
+	return NULL;
+}
+
+static bool gc_reuse_chunk(SnGCHeap* heap, size_t size) {
+	// Gives an empty heap a chunk from the pool, with its side tables. Called by any thread.
+	SnGCChunkPool* pool = gc_chunk_pool(size);
+	if (!pool) return false;
+	SnGCFreeChunk* chunk;
+	do {
+		chunk = pool->head;
+		// Chunks are only pushed while the world is stopped, so `chunk' cannot be popped and pushed
+		// back during this loop, and reading its `next' is safe even if someone else pops it first.
+	} while (chunk && !__sync_bool_compare_and_swap(&pool->head, chunk, chunk->next));
+	if (!chunk) return false;
+	
+	if (chunk->resident) __sync_fetch_and_sub(&pool->num_resident, 1);
+	__sync_fetch_and_add(&GC.info.num_chunks_reused, 1);
+	heap->start = (byte*)chunk;
+	heap->current = gc_heap_first_allocation(heap);
+	heap->end = heap->start + size;
+	heap->max_objects = size / GC_MIN_ALLOCATION_SIZE;
+	heap->flags = chunk->flags;
+	heap->object_starts = chunk->object_starts;
+	heap->cards = chunk->cards;
+	heap->has_dirty_cards = false;
+	memset(chunk, 0, sizeof(SnGCFreeChunk));
+	gc_register_heap(heap);
+	return true;
+}
+
+static bool gc_recycle_chunk(SnGCHeap* heap) {
+	/*
+		Returns the chunk of a dead heap to the pool for its size, with cleared side tables. Chunks
+		beyond the high water mark keep their address range, but their pages are given back to the
+		OS, and come back zeroed when the chunk is reused. Only called during collection.
+	*/
+	size_t size = heap->end - heap->start;
+	SnGCChunkPool* pool = gc_chunk_pool(size);
+	if (!pool) return false;
+	size_t used = heap->current - heap->start;
+	memset(heap->flags, 0, sizeof(SnGCFlags) * heap->num_objects);
+	memset(heap->object_starts, 0, gc_heap_bitmap_size(used));
+	memset(heap->cards, 0, gc_heap_num_cards(used));
+	
+	// Allocations are not initialized, and the unused parts of blobs are scanned like the rest, so
+	// a reused chunk must be as clean as a fresh one, or stale references would come back to life.
+	bool resident = pool->num_resident * size < GC_CHUNK_POOL_HIGH_WATER;
+	if (resident) {
+		__sync_fetch_and_add(&pool->num_resident, 1);
+		memset(heap->start, 0, used);
+	} else {
+		// the first page holds the header
+		memset(heap->start, 0, used < GC_PAGE_SIZE ? used : GC_PAGE_SIZE);
+		madvise(heap->start + GC_PAGE_SIZE, size - GC_PAGE_SIZE, MADV_DONTNEED);
+		++GC.info.num_chunks_released;
+	}
+	
+	SnGCFreeChunk* chunk = (SnGCFreeChunk*)heap->start;
+	chunk->flags = heap->flags;
+	chunk->object_starts = heap->object_starts;
+	chunk->cards = heap->cards;
+	chunk->resident = resident;
+	chunk->next = pool->head;
+	pool->head = chunk;
+	return true;
+}
+
+static void gc_release_nursery(SnGCHeap* heap) {
+	// Returns the chunk of an emptied nursery to the pool. Only called during collection.
+	gc_heap_finalize(heap);
+	gc_heap_init(heap);
+	heap->young = true;
+}
+
+static inline byte* gc_nursery_alloc(SnGCHeap* heap, size_t total_size, uint32_t* out_object_index) {
+	// The fast path: the nursery belongs to this thread, so a bump needs no locks. An empty nursery
+	// has start == current == end == NULL, so it takes the slow path too.
+	byte* ptr = heap->current;
+	if (ptr + total_size > heap->end) return NULL;
+	heap->current = ptr + total_size;
+	*out_object_index = heap->num_objects++;
+	return ptr;
+}
+
+static byte* gc_nursery_alloc_slow(SnGCHeap** heap, size_t total_size, uint32_t* out_object_index) {
+	if ((*heap)->start) {
+		snow_gc();
+		*heap = gc_my_nursery();
+	}
+	if (!(*heap)->start) gc_heap_init_chunk(*heap, GC_NURSERY_SIZE); // the nursery may have been pinned instead of pooled
+	byte* ptr = gc_nursery_alloc(*heap, total_size, out_object_index);
+	ASSERT(ptr); // garbage collection didn't free up enough space!
+	return ptr;
+}
+
+static inline byte* gc_size_class_alloc(size_t* size, uint32_t* out_object_index, SnGCHeap** out_heap) {
+	// A slot for an object of `*size' bytes, which is updated to the size of the slot's data.
+	byte* ptr = gc_size_class_space_alloc(&GC.size_classes, *size, out_object_index, GC_SIZE_CLASS_HEAP_SIZE, out_heap);
+	*size = (*out_heap)->slot_size - gc_calculate_total_size(0);
+	return ptr;
+}
+
+static inline bool gc_site_is_pretenured(SnGCSiteId id) {
+	// True if the next object of the site goes to the old generation, rather than the nursery.
+	SnGCSite* site = &GC.sites.sites[id];
+	return site->pretenured && __sync_add_and_fetch(&site->num_tenured, 1) % GC_PRETENURE_SAMPLE_RATE != 0;
+}
+
+static byte* gc_pretenured_alloc(size_t* size, uint32_t* out_object_index, SnGCHeap** out_heap) {
+	/*
+		Allocates an object of a pretenured site in the size class space, like a transplant, and
+		updates `*size' to the size of its data. Called by any thread, so it takes the sweeper lock,
+		which collections hold too.
+	*/
+	size_t total_size = gc_calculate_total_size(*size);
+	if (GC.pretenured_since_major > GC_PRETENURED_PER_MAJOR) {
+		snow_gc();
+	}
+	if (GC.concurrent.active && GC.options.incremental_major) gc_incremental_assist(total_size);
+	
+	pthread_mutex_lock(&GC.sweeper.lock);
+	byte* ptr = gc_size_class_alloc(size, out_object_index, out_heap);
+	total_size = gc_calculate_total_size(*size);
+	GC.pretenured_since_major += total_size;
+	GC.statistics.pretenured += total_size;
+	pthread_mutex_unlock(&GC.sweeper.lock);
+	
+	// free slots hold what was there before, and like big allocations, the object is old from birth
+	memset(ptr + sizeof(SnGCObjectHead), 0, *size);
+	gc_heap_dirty_range(*out_heap, ptr, ptr + total_size);
+	return ptr;
+}
+
+static inline void gc_nursery_set_site(uint32_t object_index, SnGCSiteId site) {
+	SnGCNursery* nursery = gc_current_nursery;
+	if (!nursery->sites) {
+		size_t size = GC_NURSERY_SIZE / GC_MIN_ALLOCATION_SIZE * sizeof(SnGCSiteId);
+		nursery->sites = (SnGCSiteId*)snow_malloc(size);
+		memset(nursery->sites, 0, size);
+	}
+	nursery->sites[object_index] = site;
+}
+
+static inline void* gc_alloc(size_t size, SnGCAllocType alloc_type, const void* site_address) {
+	// `site_address' is where the object is allocated from, for pretenuring, or NULL
 	ASSERT(size); // 0-allocations not allowed.
 	snow_gc_barrier();
 	
 	byte* ptr = NULL;
+	SnGCHeap* heap = NULL;
 	uint32_t object_index = (uint32_t)-1;
 	
-	size_t rounded_size = snow_gc_round(size);
+	size_t rounded_size = gc_round_size(size);
 	size_t total_size = gc_calculate_total_size(rounded_size);
 	
 	DTRACE_PROBE(GC_ALLOC(size));
 	
+	SnGCSiteId site = 0;
+	if (site_address && GC.options.pretenure && total_size <= GC_BIG_ALLOCATION_SIZE_LIMIT) {
+		site = gc_site_table_get(&GC.sites, site_address);
+	}
+	
 	if (total_size > GC_BIG_ALLOCATION_SIZE_LIMIT) {
-		ptr = gc_heap_list_alloc(&GC.biggies, total_size, &object_index, total_size);
+		if (GC.big_allocated_since_major > GC_BIG_ALLOCATIONS_PER_MAJOR) {
+			snow_gc();
+		}
+		size_t heap_size = (GC_ALLOCATION_OFFSET + total_size + GC_PAGE_SIZE - 1) & ~(GC_PAGE_SIZE - 1);
+		// nurseries pay for incremental marking with the collection that empties them, but big allocations bypass them
+		if (GC.concurrent.active && GC.options.incremental_major) gc_incremental_assist(heap_size);
+		
+		pthread_mutex_lock(&GC.biggies_lock);
+		heap = &gc_heap_list_push_heap(&GC.biggies, NULL)->heap;
+		heap->large = true;
+		ptr = gc_heap_alloc(heap, total_size, &object_index, heap_size);
+		GC.big_allocated_since_major += heap_size;
+		GC.statistics.allocated += heap_size;
+		++GC.stats.total;
+		pthread_mutex_unlock(&GC.biggies_lock);
 		ASSERT(ptr); // big allocation failed!
+		// big allocations are old from birth, so their initializing stores are never seen by a minor collection
+		gc_heap_dirty_range(heap, ptr, ptr + total_size);
+	}
+	else if (site && gc_site_is_pretenured(site))
+	{
+		ptr = gc_pretenured_alloc(&rounded_size, &object_index, &heap);
 	}
 	else
 	{
-		ptr = gc_heap_alloc(gc_my_nursery(), total_size, &object_index, GC_NURSERY_SIZE);
-		if (!ptr) {
-			snow_gc();
-			ptr = gc_heap_alloc(gc_my_nursery(), total_size, &object_index, GC_NURSERY_SIZE);
-			ASSERT(ptr); // garbage collection didn't free up enough space!
-		}
+		heap = gc_my_nursery();
+		ptr = gc_nursery_alloc(heap, total_size, &object_index);
+		if (!ptr) ptr = gc_nursery_alloc_slow(&heap, total_size, &object_index);
+		if (site) gc_nursery_set_site(object_index, site);
 	}
 	
-	byte* data = gc_init_allocation(ptr, rounded_size, alloc_type, object_index, NULL);
-
-	++GC.stats.total;
+	byte* data = gc_init_allocation(heap, ptr, rounded_size, alloc_type, object_index);
+	
+	if (snow_gc_is_sampling() && (gc_sample_countdown -= total_size) <= 0) gc_sample_allocation(data, total_size);
 	
 	return data;
 }
 
 SnObjectBase* snow_gc_alloc_object(uintx size) {
-	void* ptr = gc_alloc(size, GC_OBJECT);
+	void* ptr = gc_alloc(size, GC_OBJECT, NULL);
+	return (SnObjectBase*)ptr;
+}
+
+SnObjectBase* snow_gc_alloc_object_at(uintx size, const void* site) {
+	void* ptr = gc_alloc(size, GC_OBJECT, site);
 	return (SnObjectBase*)ptr;
 }
 
 VALUE* snow_gc_alloc_blob(uintx size) {
-	void* ptr = gc_alloc(size, GC_BLOB);
+	void* ptr = gc_alloc(size, GC_BLOB, NULL);
 	return (VALUE*)ptr;
 }
 
 void* snow_gc_alloc_atomic(uintx size) {
-	void* ptr = gc_alloc(size, GC_ATOMIC);
+	void* ptr = gc_alloc(size, GC_ATOMIC, NULL);
 	return ptr;
 }
 
-void* snow_gc_realloc(void* ptr, uintx size) {
+static inline bool gc_grow_in_place(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, size_t size) {
+	// Extends the most recent allocation in this thread's nursery, by bumping past it.
+	if (!gc_current_nursery || heap != &gc_current_nursery->heap) return false;
+	if (object + alloc_info->size + GC_TAIL_SIZE != heap->current) return false;
+	size_t rounded_size = gc_round_size(size);
+	byte* end = object + rounded_size + GC_TAIL_SIZE;
+	// nurseries only hold what the size class space can take when it's promoted
+	if (gc_calculate_total_size(rounded_size) > GC_BIG_ALLOCATION_SIZE_LIMIT || end > heap->end) return false;
+	
+	memset(object + alloc_info->size, 0, rounded_size - alloc_info->size); // where the tail was, with beads
+	alloc_info->size = rounded_size;
+	gc_compute_checksum(alloc_info);
+	gc_init_beads((SnGCObjectHead*)(object - sizeof(SnGCObjectHead)), end);
+	heap->current = end;
+	return true;
+}
+
+void* snow_gc_realloc_hint(void* ptr, uintx size, uintx hint) {
 	SnGCHeap* heap = gc_find_heap(ptr);
 	ASSERT(heap); // not GC-allocated memory!
 	SnGCAllocInfo* alloc_info;
-	SnGCMetaInfo* meta_info;
-	void* ptr_start = gc_find_object_start(heap, (const byte*)ptr, &alloc_info, &meta_info);
+	byte* ptr_start = gc_find_object_start(heap, (const byte*)ptr, &alloc_info);
 	ASSERT(ptr_start == ptr); // ptr is not at the beginning of the allocation!
-	if (size > alloc_info->size) {
-		void* new_ptr = gc_alloc(size, alloc_info->alloc_type);
-		if (meta_info->free_func)
-			snow_gc_set_free_func(new_ptr, meta_info->free_func);
-		ptr = new_ptr;
-	}
-	return ptr;
+	if (size <= alloc_info->size) return ptr;
+	if (hint < size) hint = size;
+	if (gc_grow_in_place(heap, ptr_start, alloc_info, hint) || gc_grow_in_place(heap, ptr_start, alloc_info, size)) return ptr;
+	
+	// `ptr' is on the stack, so it stays in place if this collects
+	size_t old_size = alloc_info->size;
+	void* new_ptr = gc_alloc(hint, alloc_info->alloc_type, NULL);
+	memcpy(new_ptr, ptr, old_size);
+	// the free function moves to the copy, or it would run on both; the entry of `ptr' in the
+	// finalizable lists stays behind, and is dropped without running anything once it has none
+	pthread_mutex_lock(&GC.finalizers.lock);
+	SnGCFreeFunc free_func = gc_finalizer_table_remove(&GC.finalizers.table, ptr);
+	pthread_mutex_unlock(&GC.finalizers.lock);
+	if (free_func)
+		snow_gc_set_free_func(new_ptr, free_func);
+	return new_ptr;
+}
+
+void* snow_gc_realloc(void* ptr, uintx size) {
+	return snow_gc_realloc_hint(ptr, size, size);
 }
 
 void snow_gc_set_free_func(const void* data, SnGCFreeFunc free_func) {
 	SnGCHeap* heap = gc_find_heap(data);
 	ASSERT(heap); // not a GC-allocated pointer
 	SnGCAllocInfo* alloc_info;
-	SnGCMetaInfo* meta_info;
-	gc_find_object_start(heap, (const byte*)data, &alloc_info, &meta_info);
-	meta_info->free_func = free_func;
+	byte* object = gc_find_object_start(heap, (const byte*)data, &alloc_info);
+	pthread_mutex_lock(&GC.finalizers.lock);
+	if (free_func && !gc_finalizer_table_get(&GC.finalizers.table, object)) {
+		gc_mark_stack_push(heap->young ? &GC.finalizers.young : &GC.finalizers.old, object);
+	}
+	gc_finalizer_table_set(&GC.finalizers.table, object, free_func);
+	pthread_mutex_unlock(&GC.finalizers.lock);
+}
+
+void snow_gc_run_finalizers() {
+	if (gc_running_finalizers) return; // a free function caused a collection
+	gc_running_finalizers = true;
+	uint64_t start = gc_now_us();
+	bool any = false;
+	for (;;) {
+		VALUE object;
+		pthread_mutex_lock(&GC.finalizers.lock);
+		bool found = gc_mark_stack_pop(&GC.finalizers.queue, &object);
+		SnGCFreeFunc free_func = found ? GC.finalizers.queued_funcs[GC.finalizers.queue.size] : NULL;
+		pthread_mutex_unlock(&GC.finalizers.lock);
+		if (!found) break;
+		
+		// `object' is only referenced from the stack now, which keeps it in place until the next collection after this one
+		free_func(object);
+		any = true;
+	}
+	if (any) {
+		uint64_t duration = gc_now_us() - start;
+		pthread_mutex_lock(&GC.statistics.lock);
+		GC.statistics.published.last_phase_time.finalize += duration;
+		GC.statistics.published.total_phase_time.finalize += duration;
+		pthread_mutex_unlock(&GC.statistics.lock);
+	}
+	gc_running_finalizers = false;
+}
+
+void snow_gc_add_weak(VALUE object) {
+	ASSERT(snow_typeof(object) == SN_WEAK_REF_TYPE || snow_typeof(object) == SN_WEAK_MAP_TYPE);
+	pthread_mutex_lock(&GC.weak.lock);
+	gc_mark_stack_push(&GC.weak.objects, object);
+	pthread_mutex_unlock(&GC.weak.lock);
 }
 
 uintx snow_gc_allocated_size(const void* data) {
 	SnGCHeap* heap = gc_find_heap(data);
 	ASSERT(heap); // not a GC-allocated pointer
 	SnGCAllocInfo* alloc_info;
-	SnGCMetaInfo* meta_info;
-	gc_find_object_start(heap, (const byte*)data, &alloc_info, &meta_info);
+	gc_find_object_start(heap, (const byte*)data, &alloc_info);
 	return alloc_info->size;
 }
 
-static inline void gc_finalize_object(void* object, SnGCAllocInfo* alloc_info, SnGCMetaInfo* meta) {
-	if (meta->free_func) {
-		meta->free_func(object);
-		meta->free_func = NULL;
-	}
+static inline void gc_finalize_object(void* object, SnGCAllocInfo* alloc_info) {
+	// dead objects with free functions were queued for the finalizers instead
 	memset(object, 0xef, alloc_info->size);
 	alloc_info->alloc_type = GC_INVALID;
 	gc_compute_checksum(alloc_info);
 	++GC.stats.freed;
 }
 
+static inline SnGCHeap* gc_lookup_heap(const void* ptr) {
+	// the heap that owns the page of ptr, if any; most pointers that aren't are rejected by the range compare
+	if (!gc_reservation_contains(&GC.reservation, ptr) && !GC.reservation.num_outside) return NULL;
+	return gc_heap_index_lookup(&GC.heap_index, ptr);
+}
+
 static inline bool gc_maybe_contains(const void* root) {
-	return (const byte*)root >= GC.lower_bound && (const byte*)root <= GC.upper_bound;
+	// true if root is on a page owned by a GC heap
+	return gc_lookup_heap(root) != NULL;
 }
 
 SnGCHeap* gc_find_heap(const void* root) {
-	if (!gc_maybe_contains(root)) return NULL;
+	// lock-free; heaps are only registered or moved by their owning thread, or during collection
+	SnGCHeap* heap = gc_lookup_heap(root);
+	if (heap && gc_heap_contains(heap, root)) return heap;
+	return NULL;
+}
+
+static void gc_concurrent_barrier(const void* value) {
+	// Records the stored reference, so the final pause can mark it if the marker has already
+	// scanned the object it was stored into.
+	if (!gc_maybe_contains(value)) return;
+	SnGCNursery* nursery = gc_current_nursery ? gc_current_nursery : add_nursery();
+	gc_mark_stack_push(&nursery->barrier_buffer, (VALUE)value);
+}
+
+void snow_gc_write_barrier(const void* slot, const void* value) {
+	if (GC.concurrent.marking) gc_concurrent_barrier(value);
 	
-	SnGCHeap* heap = NULL;
-	pthread_mutex_lock(&GC.nursery_lock);
-	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
-		if (gc_heap_contains(&nursery->heap, root)) {
-			heap = &nursery->heap;
-			break;
-		}
+	// only stores of young references into old heaps are interesting
+	if (!GC.options.generational) return;
+	SnGCHeap* value_heap = gc_lookup_heap(value);
+	if (!value_heap || !value_heap->young) return;
+	SnGCHeap* heap = gc_lookup_heap(slot);
+	if (heap && !heap->young && gc_heap_contains(heap, slot)) {
+		gc_heap_dirty_card(heap, slot);
 	}
-	pthread_mutex_unlock(&GC.nursery_lock);
-	if (heap) return heap;
-	
-	heap = gc_heap_list_find_heap(&GC.adults, root);
-	if (heap) return heap;
-	heap = gc_heap_list_find_heap(&GC.biggies, root);
-	if (heap) return heap;
-	heap = gc_heap_list_find_heap(&GC.unkillables, root);
-	if (heap) return heap;
-	heap = gc_heap_list_find_heap(&GC.graveyard, root);
-	return heap;
+}
+
+void snow_gc_safepoint() {
+	snow_gc_barrier();
 }
 
 void snow_gc() {
@@ -389,7 +1128,10 @@ void snow_gc() {
 		return;
 	}
 	
+	uint64_t pause_start = gc_now_us();
+	_snow_gc_safepoint_requested = 1; // before the barriers, or busy threads would never reach one
 	snow_set_gc_barriers();
+	uint64_t time_to_safepoint = gc_now_us() - pause_start;
 	snow_task_pause();
 	
 	ASSERT(!_snow_gc_is_collecting);
@@ -397,42 +1139,181 @@ void snow_gc() {
 	
 	DTRACE_PROBE(GC());
 	uintx mem_before = GC.info.total_mem_usage;
+	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
+		GC.stats.total += nursery->heap.num_objects; // not counted by the allocation fast path
+		GC.statistics.young_allocated += nursery->heap.current - nursery->heap.start;
+	}
+	GC.statistics.allocated += GC.statistics.young_allocated + GC.statistics.pretenured;
+	
+	// a concurrent major collection gets more time to mark before its final pause is forced
+	uint16_t max_minor_collections = GC.concurrent.active ? GC_CONCURRENT_MAX_MINOR_COLLECTIONS : 10;
+	bool major = GC.num_minor_collections_since_last_major_collection > max_minor_collections || GC.big_allocated_since_major > GC_BIG_ALLOCATIONS_PER_MAJOR || GC.pretenured_since_major > GC_PRETENURED_PER_MAJOR;
 	
-	if (GC.num_minor_collections_since_last_major_collection > 10) {
+	pthread_mutex_lock(&GC.sweeper.lock);
+	pthread_mutex_lock(&GC.concurrent.lock);
+	++GC.sweeper.epoch;
+	if (major || !GC.options.generational) {
+		// marking needs the flags of all old heaps, so the previous major collection must be swept up
+		gc_begin_phase(&GC.statistics.phase_time.sweep);
+		gc_finish_sweeping();
+	}
+	
+	if (GC.concurrent.active) {
+		// once the marker has caught up, what this minor collection shades is left to the final pause
+		bool caught_up = GC.concurrent.done;
+		gc_concurrent_minor();
+		if (major || caught_up) {
+			gc_finish_concurrent_major();
+			GC.num_minor_collections_since_last_major_collection = 0;
+			GC.big_allocated_since_major = 0;
+			GC.pretenured_since_major = 0;
+			major = true;
+		} else {
+			// a concurrent cycle marks a batch too, in case the marker thread gets no CPU time
+			if (GC.options.incremental_major) gc_incremental_slice();
+			else gc_concurrent_mark_batch();
+			++GC.num_minor_collections_since_last_major_collection;
+		}
+	} else if (major && (GC.options.concurrent_major || GC.options.incremental_major)) {
+		gc_minor();
+		gc_begin_concurrent_major();
+		GC.num_minor_collections_since_last_major_collection = 0;
+		major = false; // the flags belong to the concurrent marker now
+	} else if (major) {
 		// TODO: Better heuristics for when to perform major collections
 		gc_major();
 		GC.num_minor_collections_since_last_major_collection = 0;
+		GC.big_allocated_since_major = 0;
+		GC.pretenured_since_major = 0;
 	} else {
 		gc_minor();
 		++GC.num_minor_collections_since_last_major_collection;
 	}
 	
-	gc_clear_flags();
+	// no young objects are left, so there are no references from old objects to young ones
+	gc_clear_cards();
+	// generational minor collections never set flags outside the nurseries, and those have been reset
+	if (major || !GC.options.generational) gc_clear_flags();
+	gc_begin_phase(NULL);
+	
+	if (GC.concurrent.active) pthread_cond_signal(&GC.concurrent.wakeup);
+	pthread_mutex_unlock(&GC.concurrent.lock);
+	if (GC.sweeper.num_pending) gc_start_sweeper();
+	pthread_mutex_unlock(&GC.sweeper.lock);
 	
 	uintx mem_after = GC.info.total_mem_usage;
 	double mem_diff_mb = ((double)mem_before - (double)mem_after) / (1024.0*1024.0);
 	
-	DTRACE_PROBE(GC_FINISHED(GC.info.total_mem_usage, (int64_t)mem_after - mem_before))
+	DTRACE_PROBE(GC_FINISHED(GC.info.total_mem_usage, (int64_t)mem_after - mem_before));
 	
 	gc_clear_statistics();
+	gc_publish_statistics(major, gc_now_us() - pause_start, time_to_safepoint);
 	
 	_snow_gc_is_collecting = false;
+	_snow_gc_safepoint_requested = 0; // while the lock is held, so that it can't clear the request of the next collection
 	pthread_mutex_unlock(&GC.gc_lock);
 	snow_unset_gc_barriers();
 	snow_task_resume();
+	
+	snow_gc_run_finalizers();
+}
+
+static inline void gc_with_stack_words_do(VALUE* p, VALUE* end, SnGCAction action) {
+	while (p < end) {
+		if (gc_find_heap(*p))
+			action(p, true);
+		++p;
+	}
 }
 
 void gc_with_stack_do(byte* bottom, byte* top, SnGCAction action) {
 	ASSERT((uintx)bottom % SNOW_GC_ALIGNMENT == 0);
 	ASSERT((uintx)top % SNOW_GC_ALIGNMENT == 0);
 	
-	VALUE* p = (VALUE*)bottom;
-	VALUE* end = (VALUE*)top;
-	while (p < end) {
-		if (gc_maybe_contains(*p))
-			action(p, true);
-		++p;
+	gc_with_stack_words_do((VALUE*)bottom, (VALUE*)top, action);
+}
+
+void snow_gc_register_stack_map(const void* code, uintx code_size, uintx frame_size, const SnGCCallSite* sites, uintx num_sites) {
+	SnGCStackMap* map = (SnGCStackMap*)snow_malloc(sizeof(SnGCStackMap) + num_sites * sizeof(SnGCCallSite));
+	map->code = (const byte*)code;
+	map->code_size = code_size;
+	map->frame_size = frame_size;
+	map->num_sites = num_sites;
+	memcpy(map->sites, sites, num_sites * sizeof(SnGCCallSite));
+	
+	pthread_mutex_lock(&GC.stack_maps.lock);
+	if (GC.stack_maps.size == GC.stack_maps.capacity) {
+		GC.stack_maps.capacity = GC.stack_maps.capacity ? GC.stack_maps.capacity * 2 : 64;
+		GC.stack_maps.maps = (SnGCStackMap**)snow_realloc(GC.stack_maps.maps, GC.stack_maps.capacity * sizeof(SnGCStackMap*));
+	}
+	uintx i = GC.stack_maps.size++;
+	for (; i > 0 && GC.stack_maps.maps[i-1]->code > map->code; --i) {
+		GC.stack_maps.maps[i] = GC.stack_maps.maps[i-1];
+	}
+	GC.stack_maps.maps[i] = map;
+	pthread_mutex_unlock(&GC.stack_maps.lock);
+}
+
+static const SnGCCallSite* gc_find_call_site(const byte* return_address, uintx* out_frame_size) {
+	// GC.stack_maps.lock must be held
+	uintx lo = 0, hi = GC.stack_maps.size;
+	while (lo < hi) {
+		uintx mid = (lo + hi) / 2;
+		if (GC.stack_maps.maps[mid]->code <= return_address) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo == 0) return NULL;
+	const SnGCStackMap* map = GC.stack_maps.maps[lo-1];
+	if (return_address > map->code + map->code_size) return NULL;
+	
+	uint32_t offset = (uint32_t)(return_address - map->code);
+	lo = 0;
+	hi = map->num_sites;
+	while (lo < hi) {
+		uintx mid = (lo + hi) / 2;
+		if (map->sites[mid].return_offset < offset) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo == map->num_sites || map->sites[lo].return_offset != offset) return NULL;
+	*out_frame_size = map->frame_size;
+	return &map->sites[lo];
+}
+
+static void gc_with_task_stack_do(SnTask* task, SnGCAction action) {
+	/*
+		Follows the frame pointers from the function that paused the task. A frame whose return
+		address is a call site in a stack map was called from generated code, and the caller's live
+		slots are scanned precisely, so what they reference can be moved instead of pinned. The rest
+		of the stack -- C frames, and everything past the end of a broken chain -- is scanned
+		conservatively.
+	*/
+	VALUE* p = (VALUE*)task->stack_bottom;
+	VALUE* top = (VALUE*)task->stack_top;
+	
+	pthread_mutex_lock(&GC.stack_maps.lock);
+	VALUE* frame = GC.stack_maps.size ? (VALUE*)task->frame_ptr : NULL;
+	while (frame >= p && frame + 2 <= top && (uintx)frame % sizeof(VALUE) == 0) {
+		VALUE* caller = (VALUE*)frame[0];
+		if (caller <= frame) break;
+		
+		uintx frame_size;
+		const SnGCCallSite* site = gc_find_call_site((const byte*)frame[1], &frame_size);
+		if (site && site->live_slots && caller == (VALUE*)((byte*)(frame + 2) + frame_size) && caller <= top) {
+			uintx num_slots = 64 - __builtin_clzll(site->live_slots);
+			VALUE* slots = caller - num_slots;
+			gc_with_stack_words_do(p, slots, action);
+			for (VALUE* slot = slots; slot < caller; ++slot) {
+				bool precise = (site->live_slots >> (caller - slot - 1)) & 1;
+				if (gc_find_heap(*slot))
+					action(slot, !precise);
+			}
+			p = caller;
+		}
+		frame = caller;
 	}
+	pthread_mutex_unlock(&GC.stack_maps.lock);
+	
+	gc_with_stack_words_do(p, top, action);
 }
 
 void gc_with_definite_roots_do(SnGCAction action) {
@@ -443,13 +1324,23 @@ void gc_with_definite_roots_do(SnGCAction action) {
 	for (size_t i = 0; i < SN_TYPE_MAX; ++i) {
 		action(&types[i], false);
 	}
+	
+	for (uintx i = 0; i < GC.finalizers.queue.size; ++i) {
+		action(&GC.finalizers.queue.items[i], false);
+	}
+	
+	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
+		for (uintx i = 0; i < nursery->calls.size; ++i) {
+			action(&nursery->calls.calls[i].function, false);
+		}
+	}
 }
 
 static void do_task_stack(SnTask* task, void* userdata) {
 	SnGCAction action;
 	CAST_DATA_TO_FUNCTION(action, userdata);
 	ASSERT(task->stack_top && task->stack_bottom); // a task is alive during GC?!?!
-	gc_with_stack_do((byte*)task->stack_bottom, (byte*)task->stack_top, action);
+	gc_with_task_stack_do(task, action);
 }
 
 void gc_with_everything_do(SnGCAction action) {
@@ -458,11 +1349,87 @@ void gc_with_everything_do(SnGCAction action) {
 	gc_with_definite_roots_do(action);
 }
 
+static void gc_with_each_old_heap_do(void(*func)(SnGCHeap* heap, void* userdata), void* userdata) {
+	// only called during collection, no need to acquire locks
+	SnGCHeapList* lists[] = { &GC.adults, &GC.biggies, &GC.unkillables };
+	for (size_t i = 0; i < sizeof(lists) / sizeof(SnGCHeapList*); ++i) {
+		for (SnGCHeapListNode* node = lists[i]->head; node != NULL; node = node->next) {
+			if (node->heap.start) func(&node->heap, userdata);
+		}
+	}
+	for (size_t i = 0; i < GC_NUM_SIZE_CLASSES; ++i) {
+		for (SnGCHeapListNode* node = GC.size_classes.heaps[i].head; node != NULL; node = node->next) {
+			if (node->heap.start) func(&node->heap, userdata);
+		}
+	}
+}
+
+static void gc_scan_dirty_allocation(SnGCHeap* heap, byte* allocation, void* userdata) {
+	SnGCAction action;
+	CAST_DATA_TO_FUNCTION(action, userdata);
+	SnGCAllocInfo* alloc_info = &((SnGCObjectHead*)allocation)->alloc_info;
+	if (alloc_info->alloc_type == GC_INVALID) return;
+	// heaps that need_sweep still hold their dead and transplanted objects, whose references may dangle
+	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
+	if ((flags & GC_TRANSPLANTED) || (heap->needs_sweep && !(flags & GC_MARK))) return;
+	byte* object = allocation + sizeof(SnGCObjectHead);
+	gc_scan_object(object, alloc_info, action);
+}
+
+static void gc_heap_scan_dirty_cards(SnGCHeap* heap, void* userdata) {
+	gc_heap_with_dirty_objects_do(heap, gc_scan_dirty_allocation, userdata);
+}
+
+static void gc_with_dirty_cards_do(SnGCAction action) {
+	/*
+		Calls action for every reference in every allocation overlapping a dirty card in an old heap.
+		Together with the roots, these are all the places that can reference a young object.
+	*/
+	void* userdata;
+	CAST_FUNCTION_TO_DATA(userdata, action);
+	gc_with_each_old_heap_do(gc_heap_scan_dirty_cards, userdata);
+}
+
+static void gc_with_weak_do(SnGCAction action) {
+	/*
+		Calls action for the weak objects, and for their references. Only the update phase does this,
+		for the references to objects that moved; the values of weak maps may not be reachable
+		from anywhere else.
+	*/
+	for (uintx i = 0; i < GC.weak.objects.size; ++i) {
+		action(&GC.weak.objects.items[i], false);
+		VALUE object = GC.weak.objects.items[i];
+		if (((SnObjectBase*)object)->type == SN_WEAK_REF_TYPE) {
+			action(&((SnWeakRef*)object)->target, false);
+		} else {
+			SnWeakMap* map = (SnWeakMap*)object;
+			action((VALUE*)&map->data, false);
+			for (uintx j = 0; j < map->size; ++j) {
+				action(&map->data[j].key, false);
+				action(&map->data[j].value, false);
+			}
+		}
+	}
+}
+
+static void gc_with_roots_do(SnGCAction action) {
+	gc_with_everything_do(action);
+	if (GC.collecting_young) gc_with_dirty_cards_do(action);
+}
+
+static void gc_heap_clear_cards_action(SnGCHeap* heap, void* userdata) {
+	gc_heap_clear_cards(heap);
+}
+
+static void gc_clear_cards() {
+	gc_with_each_old_heap_do(gc_heap_clear_cards_action, NULL);
+}
+
 
 #define MEMBER(TYPE, NAME) action((VALUE*)(data + offsetof(TYPE, NAME)), false)
 #define MEMBER_ARRAY(TYPE, NAME) action((VALUE*)(data + offsetof(TYPE, NAME) + offsetof(struct array_t, data)), false)
 
-void gc_with_object_do(VALUE object, SnGCAllocInfo* alloc_info, SnGCMetaInfo* meta, SnGCAction action) {
+void gc_with_object_do(VALUE object, SnGCAllocInfo* alloc_info, SnGCAction action) {
 	ASSERT(is_object(object));
 	SnObjectBase* base = (SnObjectBase*)object;
 	byte* data = (byte*)object;
@@ -554,6 +1521,15 @@ void gc_with_object_do(VALUE object, SnGCAllocInfo* alloc_info, SnGCMetaInfo* me
 				}
 				break;
 			}
+			case SN_WEAK_REF_TYPE:
+				break; // the target is weak, see gc_clear_weak
+			case SN_WEAK_MAP_TYPE:
+				MEMBER(SnWeakMap, data); // atomic, the entries are weak
+				break;
+			case SN_DEFERRED_TASK_TYPE:
+				MEMBER(SnDeferredTask, closure);
+				MEMBER(SnDeferredTask, result);
+				break;
 			default:
 				ASSERT(false); // WTF?!
 		}
@@ -568,60 +1544,256 @@ static inline void gc_clear_flags() {
 	gc_heap_list_clear_flags(&GC.adults);
 	gc_heap_list_clear_flags(&GC.biggies);
 	gc_heap_list_clear_flags(&GC.unkillables);
+	for (size_t i = 0; i < GC_NUM_SIZE_CLASSES; ++i) {
+		gc_heap_list_clear_flags(&GC.size_classes.heaps[i]);
+	}
 }
 
 static inline void gc_with_each_object_in_heap_do(SnGCHeap* heap, SnGCHeapAction action, void* userdata) {
-	byte* p = heap->start;
+	byte* p = gc_heap_first_allocation(heap);
 	while (p < heap->current) {
 		ASSERT(gc_looks_like_allocation(p));
 		SnGCObjectHead* head = (SnGCObjectHead*)p;
 		byte* object = p + sizeof(SnGCObjectHead);
-		SnGCObjectTail* tail = (SnGCObjectTail*)(object + head->alloc_info.size);
 		
 		SnGCAllocInfo* alloc_info = &head->alloc_info;
-		SnGCMetaInfo* meta_info = &tail->meta_info;
 		
-		action(heap, object, alloc_info, meta_info, userdata);
+		action(heap, object, alloc_info, userdata);
 		
-		p = ((byte*)tail) + sizeof(SnGCObjectTail);
+		p = object + alloc_info->size + GC_TAIL_SIZE;
 	}
 }
 
-static inline void gc_invalidate_transplanted(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, SnGCMetaInfo* meta_info, void* userdata) {
-	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
-	if (flags & GC_TRANSPLANTED) {
-		alloc_info->alloc_type = GC_INVALID;
-		gc_compute_checksum(alloc_info);
+static void gc_make_hole(SnGCHeap* heap, byte* begin, byte* end) {
+	/*
+		Turns the dead allocations between begin and end into a single invalid allocation, and
+		gives the whole pages inside it back to the OS. Its head (and tail, with beads) stays
+		resident, so the heap can still be walked from allocation to allocation.
+	*/
+	SnGCObjectHead* head = (SnGCObjectHead*)begin;
+	gc_heap_clear_object_starts(heap, begin, end);
+	gc_heap_set_object_start(heap, begin);
+	head->alloc_info.size = end - begin - GC_ALLOCATION_OVERHEAD;
+	head->alloc_info.alloc_type = GC_INVALID; // keeps the object_index of the first dead allocation
+	gc_compute_checksum(&head->alloc_info);
+	gc_init_beads(head, end);
+	
+	byte* first_page = (byte*)(((uintx)(head + 1) + GC_PAGE_SIZE - 1) & ~(GC_PAGE_SIZE - 1));
+	byte* last_page = (byte*)((uintx)(end - GC_TAIL_SIZE) & ~(GC_PAGE_SIZE - 1));
+	if (first_page < last_page) {
+		madvise(first_page, last_page - first_page, MADV_DONTNEED);
+		GC.info.reclaimed_size += last_page - first_page;
+	}
+}
+
+static void gc_release_unpinned_pages(SnGCHeap* heap) {
+	/*
+		Called on an unkillable heap once its survivors have been transplanted and all references
+		updated, instead of keeping the whole heap resident for the sake of a few pinned objects.
+		Everything between the pinned objects becomes holes, which minor collections fill with
+		survivors from the nurseries, and only the pages under the pinned objects stay resident.
+	*/
+	byte* hole = NULL;
+	for (byte* p = gc_heap_first_allocation(heap); p < heap->current;) {
+		SnGCAllocInfo* alloc_info = &((SnGCObjectHead*)p)->alloc_info;
+		byte* next = p + gc_calculate_total_size(alloc_info->size);
+		if (alloc_info->alloc_type == GC_INVALID || (gc_heap_get_flags(heap, alloc_info->object_index) & GC_TRANSPLANTED)) {
+			if (!hole) hole = p;
+		} else {
+			// dead objects were finalized and live ones transplanted, so this one is pinned
+			if (hole) gc_make_hole(heap, hole, p);
+			hole = NULL;
+			GC.info.pinned_size += next - p;
+		}
+		p = next;
 	}
+	if (hole) gc_make_hole(heap, hole, heap->current);
 }
 
-static inline void gc_transplant_or_finalize_object(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, SnGCMetaInfo* meta_info, void* userdata) {
+static inline void gc_transplant_or_finalize_object(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, void* userdata) {
+	if (alloc_info->alloc_type == GC_INVALID) return; // already dead
 	SnGCHeapList* transplant_to = (SnGCHeapList*)userdata;
 	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
 	if (flags & GC_MARK) {
 		if (flags & GC_INDEFINITE) {
 			// indefinitely referenced, can't transplant the object :(
 		} else {
-			gc_transplant(object, alloc_info, meta_info, transplant_to);
+			gc_transplant(object, alloc_info, transplant_to);
 			gc_heap_set_flags(heap, alloc_info->object_index, GC_TRANSPLANTED);
+			if (heap->young) {
+				size_t total_size = gc_calculate_total_size(alloc_info->size);
+				GC.statistics.promoted += total_size;
+				GC.statistics.survived += total_size;
+				DTRACE_PROBE(GC_PROMOTE((uint64_t)object, (uint64_t)*(byte**)object, total_size));
+			}
 			--heap->num_reachable;
 		}
 	} else {
-		gc_finalize_object(object, alloc_info, meta_info);
+		gc_finalize_object(object, alloc_info);
 	}
 }
 
 static inline void gc_sweep_heap(SnGCHeap* heap, SnGCHeapList* transplant_to) {
+	// transplant_to is NULL to move the survivors into the size class space
 	gc_with_each_object_in_heap_do(heap, gc_transplant_or_finalize_object, transplant_to);
 }
 
+static inline SnGCHeapList* gc_old_generation() {
+	// where survivors are transplanted to, for gc_sweep_heap
+	return GC.options.copying_major ? &GC.adults : NULL;
+}
+
+static inline void gc_free_unmarked_object(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, void* userdata) {
+	if (alloc_info->alloc_type == GC_INVALID) return; // already in the free list
+	if (!(gc_heap_get_flags(heap, alloc_info->object_index) & GC_MARK)) {
+		gc_finalize_object(object, alloc_info);
+		gc_heap_free_slot(heap, object - sizeof(SnGCObjectHead));
+	}
+}
+
+static void gc_defer_sweep(SnGCHeap* heap) {
+	heap->needs_sweep = true;
+	++GC.sweeper.num_pending;
+}
+
+static void gc_lazy_sweep_heap(SnGCHeap* heap, bool in_background) {
+	/*
+		Sweeps a heap that was left with its flags after a major collection. Size class heaps get
+		their dead objects freed; unkillable heaps get everything but their pinned objects released.
+		
+		Called with the sweeper lock held, either from the sweeper thread while the world is running,
+		or during collection. Dead objects with free functions were queued for the finalizers instead,
+		so the sweeper thread never runs one.
+	*/
+	ASSERT(heap->needs_sweep);
+	if (!heap->slot_size) {
+		gc_release_unpinned_pages(heap);
+	} else {
+		byte* p = gc_heap_first_allocation(heap);
+		while (p < heap->current) {
+			SnGCAllocInfo* alloc_info = &((SnGCObjectHead*)p)->alloc_info;
+			byte* object = p + sizeof(SnGCObjectHead);
+			byte* next = object + alloc_info->size + GC_TAIL_SIZE;
+			
+			if (alloc_info->alloc_type != GC_INVALID && !(gc_heap_get_flags(heap, alloc_info->object_index) & GC_MARK)) {
+				gc_finalize_object(object, alloc_info);
+				gc_heap_free_slot(heap, p);
+			}
+			p = next;
+		}
+	}
+	gc_heap_clear_flags(heap);
+	heap->needs_sweep = false;
+	--GC.sweeper.num_pending;
+}
+
+static SnGCHeap* gc_next_pending_heap() {
+	if (!GC.sweeper.num_pending) return NULL;
+	for (SnGCHeapListNode* node = GC.unkillables.head; node != NULL; node = node->next) {
+		if (node->heap.needs_sweep) return &node->heap;
+	}
+	for (size_t i = 0; i < GC_NUM_SIZE_CLASSES; ++i) {
+		for (SnGCHeapListNode* node = GC.size_classes.heaps[i].head; node != NULL; node = node->next) {
+			if (node->heap.needs_sweep) return &node->heap;
+		}
+	}
+	ASSERT(false); // num_pending is wrong
+	return NULL;
+}
+
+static void gc_finish_sweeping() {
+	// only called during collection
+	SnGCHeap* heap;
+	while ((heap = gc_next_pending_heap())) {
+		gc_lazy_sweep_heap(heap, false);
+	}
+}
+
+static void* gc_sweeper_main(void* unused) {
+	/*
+		Sweeps one heap at a time, releasing the lock in between, so a collection never waits for
+		more than a single heap.
+	*/
+	pthread_mutex_lock(&GC.sweeper.lock);
+	for (;;) {
+		while (!GC.sweeper.num_pending) {
+			pthread_cond_wait(&GC.sweeper.wakeup, &GC.sweeper.lock);
+		}
+		gc_lazy_sweep_heap(gc_next_pending_heap(), true);
+		pthread_mutex_unlock(&GC.sweeper.lock);
+		sched_yield();
+		pthread_mutex_lock(&GC.sweeper.lock);
+	}
+	return NULL;
+}
+
+static void gc_start_sweeper() {
+	// called with the sweeper lock held
+	if (!GC.sweeper.started) {
+		int r = pthread_create(&GC.sweeper.thread, NULL, gc_sweeper_main, NULL);
+		ASSERT(r == 0); // could not start GC sweeper thread
+		pthread_detach(GC.sweeper.thread);
+		GC.sweeper.started = true;
+	}
+	pthread_cond_signal(&GC.sweeper.wakeup);
+}
+
+static void gc_sweep_size_classes(SnGCHeapList* evacuate, bool compact) {
+	/*
+		Sweeps the size class space in place, or with lazy sweeping, leaves it for later. Heaps that
+		are mostly garbage are moved to `evacuate` instead, so their survivors can be transplanted into
+		the free slots of the others. Without `compact', only heaps that are all garbage are.
+	*/
+	for (size_t i = 0; i < GC_NUM_SIZE_CLASSES; ++i) {
+		SnGCHeapList* list = &GC.size_classes.heaps[i];
+		for (SnGCHeapListNode* node = list->head; node != NULL;) {
+			SnGCHeap* heap = &node->heap;
+			bool fragmented = compact ? heap->num_reachable * 100 < heap->num_objects * GC_FRAGMENTED_PERCENT : heap->num_reachable == 0;
+			if (fragmented && heap->num_indefinite == 0) {
+				gc_heap_list_push_heap(evacuate, heap);
+				memset(heap, 0, sizeof(SnGCHeap));
+				node = gc_heap_list_erase(list, node);
+			} else {
+				if (GC.options.lazy_sweep) {
+					gc_defer_sweep(heap);
+				} else {
+					gc_with_each_object_in_heap_do(heap, gc_free_unmarked_object, NULL);
+				}
+				node = node->next;
+			}
+		}
+	}
+	gc_size_class_space_reset_cursors(&GC.size_classes);
+}
+
 static inline void gc_sweep_nurseries() {
 	// only called during collection, no need to acquire locks
+	GC.holes.node = GC.unkillables.head;
+	GC.holes.next = NULL;
 	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
 		SnGCHeap* heap = &nursery->heap;
 		if (heap->start == NULL) continue;
 
-		gc_sweep_heap(heap, &GC.adults);
+		gc_sweep_heap(heap, gc_old_generation());
+	}
+	GC.holes.node = NULL;
+}
+
+static void gc_count_site_survivors() {
+	// Counts the objects of each site that survived, once marking is done, and decides on the sites that have enough.
+	if (!GC.options.pretenure) return;
+	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
+		SnGCHeap* heap = &nursery->heap;
+		if (!nursery->sites || heap->start == NULL) continue;
+		for (uint32_t i = 0; i < heap->num_objects; ++i) {
+			SnGCSiteId id = nursery->sites[i];
+			if (!id) continue;
+			SnGCSite* site = &GC.sites.sites[id];
+			++site->allocated;
+			if (gc_heap_get_flags(heap, i) & GC_MARK) ++site->survived;
+			gc_site_decide(site);
+		}
+		memset(nursery->sites, 0, heap->num_objects * sizeof(SnGCSiteId));
 	}
 }
 
@@ -631,10 +1803,17 @@ static inline void gc_reset_or_save_nurseries() {
 		SnGCHeap* heap = &nursery->heap;
 		
 		if (heap->num_indefinite > 0) {
-			gc_heap_list_push_heap(&GC.unkillables, heap);
+			// keep only the pages under the pinned objects
+			uintx pinned_before = GC.info.pinned_size;
+			gc_release_unpinned_pages(heap);
+			GC.statistics.survived += GC.info.pinned_size - pinned_before;
+			SnGCHeap* unkillable = &gc_heap_list_push_heap(&GC.unkillables, heap)->heap;
+			unkillable->young = false;
+			gc_heap_clear_flags(unkillable);
 			memset(heap, 0, sizeof(SnGCHeap));
+			heap->young = true;
 		} else {
-			gc_heap_finalize(heap);
+			gc_release_nursery(heap);
 		}
 	}
 }
@@ -642,17 +1821,51 @@ static inline void gc_reset_or_save_nurseries() {
 void gc_minor() {
 	DTRACE_PROBE(GC_MINOR());
 	
-	gc_with_everything_do(gc_mark_root);
-
+	// Old objects can only reference young ones through the dirty cards, so leave them alone.
+	GC.collecting_young = GC.options.generational;
+	
+	gc_begin_phase(&GC.statistics.phase_time.mark);
+	gc_mark_everything();
+	gc_mark_ephemerons();
+	gc_clear_weak();
+	gc_decide_samples(!GC.collecting_young);
+	gc_queue_dead_finalizable(&GC.finalizers.young, true);
+	gc_drop_dead_weak();
+	
+	gc_begin_phase(&GC.statistics.phase_time.sweep);
+	gc_count_site_survivors();
 	gc_sweep_nurseries();
-
-	gc_with_everything_do(gc_update_root);
 	
+	gc_begin_phase(&GC.statistics.phase_time.update);
+	if (GC.collecting_young) {
+		gc_update_young();
+	} else {
+		gc_update_everything();
+	}
+	
+	gc_forward_finalizable(&GC.finalizers.young, &GC.finalizers.old);
+	gc_begin_phase(&GC.statistics.phase_time.sweep);
 	gc_reset_or_save_nurseries();
 	
-	// At this point, the "unkillable" heaps may still contain transplanted objects, so mark them as invalid pointers
-	for (SnGCHeapListNode* node = GC.unkillables.head; node != NULL; node = node->next) {
-		gc_with_each_object_in_heap_do(&node->heap, gc_invalidate_transplanted, NULL);
+	GC.collecting_young = false;
+	if (GC.concurrent.active) {
+		gc_begin_phase(&GC.statistics.phase_time.mark);
+		gc_concurrent_shade_promoted();
+	}
+	GC.promoted.size = 0;
+}
+
+static void gc_sweep_biggies() {
+	// Big objects are never moved. Unmap the dead ones.
+	for (SnGCHeapListNode* node = GC.biggies.head; node != NULL;) {
+		SnGCHeap* heap = &node->heap;
+		if (heap->num_reachable > 0) {
+			node = node->next;
+		} else {
+			// don't use gc_finalize_object, which would touch every page of the object just before unmapping it
+			++GC.stats.freed;
+			node = gc_heap_list_erase(&GC.biggies, node); // unmaps the chunk
+		}
 	}
 }
 
@@ -664,18 +1877,37 @@ void gc_major() {
 	gc_minor();
 	gc_clear_flags();
 	
-	gc_with_everything_do(gc_mark_root);
+	gc_begin_phase(&GC.statistics.phase_time.mark);
+	gc_mark_everything();
+	gc_mark_ephemerons();
+	gc_clear_weak();
+	gc_decide_samples(true);
+	gc_queue_dead_finalizable(&GC.finalizers.old, false);
+	gc_drop_dead_weak();
+	
+	gc_major_sweep(true);
+}
+
+static void gc_major_sweep(bool compact) {
+	// now all objects are in the size class, adult, unkillable, or big heaps, so deal with them with different strategies
+	uint32_t num_moved_by_minor = GC.stats.moved;
+	gc_begin_phase(&GC.statistics.phase_time.sweep);
 	
-	// now all objects are in the adult, unkillable, or big heaps, so deal with them with different strategies
+	// Sweep the size class space in place first, so the transplants below can reuse the freed slots.
+	// Transplanted objects are not marked, and must not be swept.
+	SnGCHeapList evacuate;
+	gc_heap_list_init(&evacuate);
+	if (!GC.options.copying_major) gc_sweep_size_classes(&evacuate, compact);
 	
 	// compact the adult heaps by reallocating all reachable adult objects
 	SnGCHeapList new_adults;
 	SnGCHeapList new_unkillables;
 	gc_heap_list_init(&new_adults);
 	gc_heap_list_init(&new_unkillables);
+	SnGCHeapList* transplant_to = GC.options.copying_major ? &new_adults : NULL;
 	for (SnGCHeapListNode* node = GC.adults.head; node != NULL;) {
 		SnGCHeap* heap = &node->heap;
-		gc_sweep_heap(heap, &new_adults);
+		gc_sweep_heap(heap, transplant_to);
 		if (heap->num_indefinite > 0) {
 			// something was not put in new_adults
 			gc_heap_list_push_heap(&new_unkillables, heap);
@@ -692,7 +1924,7 @@ void gc_major() {
 	// check unkillables for reachable objects -- don't touch them if there are reachable objects
 	for (SnGCHeapListNode* node = GC.unkillables.head; node != NULL;) {
 		SnGCHeap* heap = &node->heap;
-		gc_sweep_heap(heap, &GC.adults);
+		gc_sweep_heap(heap, gc_old_generation());
 		if (heap->num_indefinite > 0) {
 			node = node->next;
 		} else {
@@ -712,9 +1944,26 @@ void gc_major() {
 	ASSERT(new_unkillables.head == NULL);
 	gc_heap_list_clear(&new_unkillables);
 	
-	// TODO: Big objects
+	// evacuate the fragmented size class heaps
+	for (SnGCHeapListNode* node = evacuate.head; node != NULL;) {
+		SnGCHeap* heap = &node->heap;
+		gc_sweep_heap(heap, NULL);
+		gc_heap_list_push_heap(&GC.graveyard, heap);
+		memset(heap, 0, sizeof(SnGCHeap));
+		node = gc_heap_list_erase(&evacuate, node);
+	}
+	ASSERT(evacuate.head == NULL);
+	gc_heap_list_clear(&evacuate);
 	
-	gc_with_everything_do(gc_update_root);
+	if (GC.stats.moved != num_moved_by_minor) {
+		// only necessary if something moved
+		gc_begin_phase(&GC.statistics.phase_time.update);
+		gc_update_everything();
+		gc_begin_phase(&GC.statistics.phase_time.sweep);
+	}
+	
+	gc_sweep_biggies();
+	gc_forward_finalizable(&GC.finalizers.old, &GC.finalizers.old);
 	
 	// pointers updates, let's scrap the graveyard
 	for (SnGCHeapListNode* node = GC.graveyard.head; node != NULL;) {
@@ -724,85 +1973,713 @@ void gc_major() {
 	ASSERT(GC.graveyard.head == NULL);
 	gc_heap_list_clear(&GC.graveyard);
 	
-	// At this point, the "unkillable" heaps may still contain transplanted objects, so mark them as invalid pointers
+	// At this point, the "unkillable" heaps may still contain transplanted objects, so release all but their pinned objects
+	GC.info.pinned_size = GC.info.reclaimed_size = 0;
 	for (SnGCHeapListNode* node = GC.unkillables.head; node != NULL; node = node->next) {
-		gc_with_each_object_in_heap_do(&node->heap, gc_invalidate_transplanted, NULL);
+		if (GC.options.lazy_sweep) {
+			gc_defer_sweep(&node->heap);
+		} else {
+			gc_release_unpinned_pages(&node->heap);
+		}
 	}
 }
 
-static inline void gc_transplant(byte* object, SnGCAllocInfo* alloc_info, SnGCMetaInfo* meta, SnGCHeapList* transplant_to) {
+static byte* gc_hole_alloc(size_t total_size, uint32_t* out_object_index, SnGCHeap** out_heap) {
+	/*
+		Allocates from the holes around pinned objects, from the cursor in GC.holes on. A hole that
+		is too small is kept for later allocations, unless it is smaller than GC_HOLE_SKIP_SIZE, so
+		each allocation passes over at most one hole that it does not fit in.
+	*/
+	while (GC.holes.node) {
+		SnGCHeap* heap = &GC.holes.node->heap;
+		byte* p = GC.holes.next ? GC.holes.next : gc_heap_first_allocation(heap);
+		if (!heap->needs_sweep) {
+			// the lazy sweep has not made the holes yet if it does
+			while (p < heap->current && ((SnGCObjectHead*)p)->alloc_info.alloc_type != GC_INVALID) {
+				p += gc_calculate_total_size(((SnGCObjectHead*)p)->alloc_info.size);
+			}
+		}
+		if (heap->needs_sweep || p >= heap->current || heap->num_objects >= heap->max_objects) {
+			GC.holes.node = GC.holes.node->next;
+			GC.holes.next = NULL;
+			continue;
+		}
+		
+		SnGCAllocInfo* hole = &((SnGCObjectHead*)p)->alloc_info;
+		size_t hole_size = gc_calculate_total_size(hole->size);
+		if (hole_size == total_size || hole_size >= total_size + GC_MIN_ALLOCATION_SIZE) {
+			if (hole_size > total_size) {
+				// the rest of the hole keeps its object_index
+				SnGCObjectHead* rest = (SnGCObjectHead*)(p + total_size);
+				rest->alloc_info = *hole;
+				rest->alloc_info.size = hole_size - total_size - gc_calculate_total_size(0);
+				gc_compute_checksum(&rest->alloc_info);
+				gc_init_beads(rest, p + hole_size);
+				gc_heap_set_object_start(heap, (byte*)rest);
+			}
+			GC.holes.next = p + total_size;
+			*out_object_index = heap->num_objects++;
+			*out_heap = heap;
+			return p;
+		}
+		if (hole_size >= GC_HOLE_SKIP_SIZE) return NULL;
+		GC.holes.next = p + hole_size;
+	}
+	return NULL;
+}
+
+static inline void gc_transplant(byte* object, SnGCAllocInfo* alloc_info, SnGCHeapList* transplant_to) {
 	size_t size = alloc_info->size;
-	ASSERT(size % SNOW_GC_ALIGNMENT == 0);
 	size_t total_size = gc_calculate_total_size(size);
+	ASSERT(total_size % SNOW_GC_ALIGNMENT == 0);
 	
 	uint32_t object_index;
-	byte* new_ptr = gc_heap_list_alloc(transplant_to, total_size, &object_index, GC_ADULT_SIZE);
-	byte* new_object = gc_init_allocation(new_ptr, size, alloc_info->alloc_type, object_index, meta->free_func);
+	SnGCHeap* heap;
+	byte* new_ptr;
+	size_t new_size = size;
+	if (GC.holes.node && (new_ptr = gc_hole_alloc(total_size, &object_index, &heap))) {
+		// promoted into the dead space around pinned objects
+	} else if (transplant_to) {
+		new_ptr = gc_heap_list_alloc(transplant_to, total_size, &object_index, GC_ADULT_SIZE, &heap);
+	} else {
+		new_ptr = gc_size_class_alloc(&new_size, &object_index, &heap);
+	}
+	byte* new_object = gc_init_allocation(heap, new_ptr, new_size, alloc_info->alloc_type, object_index);
 	memcpy(new_object, object, size);
+	memset(new_object + size, 0, new_size - size); // the rest of the slot is scanned too
 	memset(object, 0xef, size);
 	// place new pointer in the beginning of the old memory
 	*(byte**)object = new_object;
 	++GC.stats.moved;
+	if (GC.collecting_young) gc_mark_stack_push(&GC.promoted, new_object);
+}
+
+static inline void gc_scan_object(byte* object, SnGCAllocInfo* alloc_info, SnGCAction action) {
+	switch (alloc_info->alloc_type) {
+		case GC_OBJECT:
+		{
+			gc_with_object_do(object, alloc_info, action);
+			break;
+		}
+		case GC_BLOB:
+		{
+			VALUE* blob = (VALUE*)object;
+			for (size_t i = 0; i < alloc_info->size / sizeof(VALUE); ++i) {
+				action(blob + i, false);
+			}
+			break;
+		}
+		case GC_ATOMIC:
+		break; // do nothing; it's atomic.
+	}
+}
+
+static inline bool gc_mark_flags(SnGCHeap* heap, const SnGCAllocInfo* alloc_info, bool on_stack, SnGCStats* stats, bool parallel) {
+	/*
+		Sets GC_MARK (and GC_INDEFINITE for stack roots) on the allocation, counting only the bits
+		that were not already set. Returns true if the object was not marked before, i.e. if the
+		caller should scan it.
+	*/
+	SnGCFlags wanted = on_stack ? (GC_MARK | GC_INDEFINITE) : GC_MARK;
+	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
+	if ((flags & wanted) == wanted) return false;
+	
+	SnGCFlags added;
+	if (parallel) {
+		added = wanted & ~gc_heap_fetch_and_set_flags(heap, alloc_info->object_index, wanted);
+		if (added & GC_INDEFINITE) __sync_fetch_and_add(&heap->num_indefinite, 1);
+		if (added & GC_MARK) __sync_fetch_and_add(&heap->num_reachable, 1);
+	} else {
+		added = wanted & ~flags;
+		gc_heap_set_flags(heap, alloc_info->object_index, wanted);
+		if (added & GC_INDEFINITE) ++heap->num_indefinite;
+		if (added & GC_MARK) ++heap->num_reachable;
+	}
+	
+	if (added & GC_INDEFINITE) ++stats->indefinites;
+	if (added & GC_MARK) {
+		++stats->survived;
+		return true;
+	}
+	return false;
+}
+
+static inline bool gc_is_marking_heap(const SnGCHeap* heap) {
+	// minor collections only mark the nurseries, and the concurrent marker leaves them alone
+	return heap->young ? !GC.collecting_old : !GC.collecting_young;
+}
+
+static inline void gc_prefetch_allocation(VALUE value) {
+	// the header is what gets read first when the value is popped
+	__builtin_prefetch((byte*)value - sizeof(SnGCObjectHead));
+}
+
+static void gc_mark_overflowed(VALUE value) {
+	// The mark stack is full, so mark the object now, but leave its children for the rescan.
+	SnGCHeap* heap = gc_find_heap(value);
+	if (!heap || !gc_is_marking_heap(heap)) return;
+	SnGCAllocInfo* alloc_info;
+	gc_find_object_start(heap, (const byte*)value, &alloc_info);
+	if (alloc_info->alloc_type == GC_INVALID) return;
+	if (gc_mark_flags(heap, alloc_info, false, &GC.stats, false) && alloc_info->alloc_type != GC_ATOMIC) {
+		gc_heap_set_flags(heap, alloc_info->object_index, GC_OVERFLOWED);
+	}
+}
+
+static void gc_mark_push(VALUE* root_p, bool on_stack) {
+	// Defers marking of a child reference to the mark stack.
+	VALUE value = *root_p;
+	SnGCHeap* heap = gc_lookup_heap(value);
+	if (!heap || !gc_is_marking_heap(heap)) return;
+	gc_prefetch_allocation(value);
+	if (!gc_mark_stack_push(&GC.mark_stack, value)) {
+		gc_mark_overflowed(value);
+	}
+}
+
+static inline void gc_mark_value(VALUE value, bool on_stack) {
+	SnGCHeap* heap = gc_find_heap(value);
+	if (heap && gc_is_marking_heap(heap)) {
+		SnGCAllocInfo* alloc_info;
+		byte* object = gc_find_object_start(heap, (const byte*)value, &alloc_info);
+		
+		if (alloc_info->alloc_type == GC_INVALID) return; // stale pointer
+		
+		if (gc_mark_flags(heap, alloc_info, on_stack, &GC.stats, false)) {
+			gc_scan_object(object, alloc_info, gc_mark_push);
+		}
+	}
 }
 
 void gc_mark_root(VALUE* root_p, bool on_stack) {
+	gc_mark_value(*root_p, on_stack);
+}
+
+static void gc_mark_drain_stack() {
+	VALUE value;
+	while (gc_mark_stack_pop(&GC.mark_stack, &value)) {
+		gc_mark_value(value, false);
+	}
+}
+
+static void gc_rescan_overflowed_for_mark(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, void* userdata) {
+	if (alloc_info->alloc_type == GC_INVALID) return;
+	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
+	if ((flags & (GC_MARK | GC_OVERFLOWED)) == (GC_MARK | GC_OVERFLOWED)) {
+		gc_heap_unset_flags(heap, alloc_info->object_index, GC_OVERFLOWED);
+		gc_scan_object(object, alloc_info, gc_mark_push);
+		gc_mark_drain_stack();
+	}
+}
+
+static void gc_with_each_heap_do(void(*func)(SnGCHeap* heap, void* userdata), void* userdata) {
+	// only called during collection, no need to acquire locks
+	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
+		if (nursery->heap.start) func(&nursery->heap, userdata);
+	}
+	gc_with_each_old_heap_do(func, userdata);
+	for (SnGCHeapListNode* node = GC.graveyard.head; node != NULL; node = node->next) {
+		if (node->heap.start) func(&node->heap, userdata);
+	}
+}
+
+static void gc_rescan_heap(SnGCHeap* heap, void* userdata) {
+	if (GC.collecting_young && !heap->young) return; // nothing else was marked
+	SnGCHeapAction action;
+	CAST_DATA_TO_FUNCTION(action, userdata);
+	gc_with_each_object_in_heap_do(heap, action, NULL);
+}
+
+static void gc_mark_rescan_overflowed() {
+	/*
+		Objects flagged with GC_OVERFLOWED are marked, but their children were never pushed.
+		Rescanning can overflow again, so keep going until a whole pass completes without overflow.
+	*/
+	while (GC.mark_stack.overflowed) {
+		GC.mark_stack.overflowed = false;
+		void* action;
+		CAST_FUNCTION_TO_DATA(action, gc_rescan_overflowed_for_mark);
+		gc_with_each_heap_do(gc_rescan_heap, action);
+	}
+}
+
+void gc_mark_root_parallel(VALUE* root_p, bool on_stack) {
+	// Like gc_mark_root, but defers scanning to the mark deque of the current worker.
 	SnGCHeap* heap = gc_find_heap(*root_p);
-	if (heap) {
+	if (heap && !(GC.collecting_young && !heap->young)) {
 		SnGCAllocInfo* alloc_info;
-		SnGCMetaInfo* meta;
-		byte* object = gc_find_object_start(heap, (const byte*)*root_p, &alloc_info, &meta);
+		byte* object = gc_find_object_start(heap, (const byte*)*root_p, &alloc_info);
 		
 		if (alloc_info->alloc_type == GC_INVALID) return; // stale pointer
 		
-		SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
+		if (gc_mark_flags(heap, alloc_info, on_stack, &gc_current_worker->stats, true) && alloc_info->alloc_type != GC_ATOMIC) {
+			if (gc_mark_deque_size(&gc_current_worker->deque) >= GC.options.mark_stack_limit) {
+				// deque is full; leave the children for the rescan
+				gc_heap_fetch_and_set_flags(heap, alloc_info->object_index, GC_OVERFLOWED);
+				GC.pool.overflowed = true;
+				return;
+			}
+			__builtin_prefetch(object);
+			SnGCMarkItem item = { object, alloc_info };
+			gc_mark_deque_push(&gc_current_worker->deque, &item);
+		}
+	}
+}
 
-		SnGCFlags new_flags = flags | GC_MARK;
-		if (on_stack) {
-			new_flags |= GC_INDEFINITE;
+static inline void gc_mark_item(const SnGCMarkItem* item) {
+	gc_scan_object(item->object, item->alloc_info, gc_mark_root_parallel);
+}
+
+static bool gc_steal_mark_work(SnGCWorker* worker, SnGCMarkItem* out_item) {
+	uint32_t n = GC.pool.num_workers;
+	for (uint32_t i = 1; i < n; ++i) {
+		SnGCWorker* victim = &GC.pool.workers[(worker->index + i) % n];
+		if (gc_mark_deque_steal(&victim->deque, &worker->deque, out_item)) return true;
+	}
+	return false;
+}
+
+static bool gc_any_mark_work() {
+	for (uint32_t i = 0; i < GC.pool.num_workers; ++i) {
+		if (gc_mark_deque_size(&GC.pool.workers[i].deque)) return true;
+	}
+	return false;
+}
+
+static void gc_mark_drain(SnGCWorker* worker) {
+	/*
+		Process mark work until every worker is out of work. A worker only pushes new work while
+		it is counted in GC.pool.num_active, so when the count drops to zero, all deques are empty
+		and marking is done.
+	*/
+	SnGCMarkItem item;
+	for (;;) {
+		while (gc_mark_deque_pop(&worker->deque, &item) || gc_steal_mark_work(worker, &item)) {
+			gc_mark_item(&item);
 		}
 		
-		if (flags != new_flags) {
-			gc_heap_set_flags(heap, alloc_info->object_index, new_flags);
-			
-			if (new_flags & GC_INDEFINITE) {
-				++heap->num_indefinite;
-				++GC.stats.indefinites;
-			}
-			if (new_flags & GC_MARK) {
-				++heap->num_reachable;
-				++GC.stats.survived;
+		__sync_fetch_and_sub(&GC.pool.num_active, 1);
+		for (uintx spins = 1;; ++spins) {
+			if (GC.pool.num_active == 0) return;
+			if (gc_any_mark_work()) {
+				__sync_fetch_and_add(&GC.pool.num_active, 1);
+				if (gc_steal_mark_work(worker, &item)) {
+					gc_mark_item(&item);
+					break;
+				}
+				__sync_fetch_and_sub(&GC.pool.num_active, 1);
 			}
+			if (spins % 64 == 0) sched_yield(); // there may be more workers than cores
+			else gc_spin_pause();
 		}
+	}
+}
+
+static void* gc_worker_main(void* _worker) {
+	SnGCWorker* worker = (SnGCWorker*)_worker;
+	gc_current_worker = worker;
+	
+	pthread_mutex_lock(&GC.pool.lock);
+	for (;;) {
+		while (GC.pool.epoch == worker->epoch) {
+			pthread_cond_wait(&GC.pool.wakeup, &GC.pool.lock);
+		}
+		worker->epoch = GC.pool.epoch;
+		pthread_mutex_unlock(&GC.pool.lock);
 		
-		if (!(flags & GC_MARK)) {
-			// was not already marked
-			switch (alloc_info->alloc_type) {
-				case GC_OBJECT:
-				{
-					gc_with_object_do(object, alloc_info, meta, gc_mark_root);
-					break;
-				}
-				case GC_BLOB:
-				{
-					VALUE* blob = (VALUE*)object;
-					for (size_t i = 0; i < alloc_info->size / sizeof(VALUE); ++i) {
-						gc_mark_root(blob + i, false);
-					}
-					break;
+		gc_mark_drain(worker);
+		
+		pthread_mutex_lock(&GC.pool.lock);
+		if (++GC.pool.num_done == GC.pool.num_workers - 1) {
+			pthread_cond_signal(&GC.pool.done);
+		}
+	}
+	return NULL;
+}
+
+static void gc_start_workers() {
+	// only called during collection
+	uint32_t n = GC.options.num_mark_threads;
+	GC.pool.workers = (SnGCWorker*)snow_malloc(sizeof(SnGCWorker) * n);
+	memset(GC.pool.workers, 0, sizeof(SnGCWorker) * n);
+	GC.pool.num_workers = n;
+	for (uint32_t i = 0; i < n; ++i) {
+		SnGCWorker* worker = &GC.pool.workers[i];
+		worker->index = i;
+		worker->epoch = GC.pool.epoch;
+		gc_mark_deque_init(&worker->deque);
+	}
+	for (uint32_t i = 1; i < n; ++i) {
+		SnGCWorker* worker = &GC.pool.workers[i];
+		int r = pthread_create(&worker->thread, NULL, gc_worker_main, worker);
+		ASSERT(r == 0); // could not start GC worker thread
+		pthread_detach(worker->thread);
+	}
+}
+
+static void gc_parallel_mark() {
+	if (!GC.pool.workers) gc_start_workers();
+	
+	SnGCWorker* self = &GC.pool.workers[0];
+	gc_current_worker = self;
+	
+	// roots are scanned by the collecting thread, and stolen from its deque by the others
+	gc_with_roots_do(gc_mark_root_parallel);
+	
+	pthread_mutex_lock(&GC.pool.lock);
+	GC.pool.num_active = GC.pool.num_workers;
+	GC.pool.num_done = 0;
+	++GC.pool.epoch;
+	pthread_cond_broadcast(&GC.pool.wakeup);
+	pthread_mutex_unlock(&GC.pool.lock);
+	
+	gc_mark_drain(self);
+	
+	pthread_mutex_lock(&GC.pool.lock);
+	while (GC.pool.num_done < GC.pool.num_workers - 1) {
+		pthread_cond_wait(&GC.pool.done, &GC.pool.lock);
+	}
+	pthread_mutex_unlock(&GC.pool.lock);
+	
+	for (uint32_t i = 0; i < GC.pool.num_workers; ++i) {
+		SnGCStats* stats = &GC.pool.workers[i].stats;
+		GC.stats.survived += stats->survived;
+		GC.stats.indefinites += stats->indefinites;
+		memset(stats, 0, sizeof(SnGCStats));
+	}
+	gc_current_worker = NULL;
+	
+	if (GC.pool.overflowed) {
+		GC.pool.overflowed = false;
+		GC.mark_stack.overflowed = true;
+	}
+}
+
+static void gc_mark_everything() {
+	if (GC.options.num_mark_threads > 1) {
+		gc_parallel_mark();
+	} else {
+		gc_with_roots_do(gc_mark_root);
+		gc_mark_drain_stack();
+	}
+	gc_mark_rescan_overflowed();
+}
+
+static void gc_queue_dead_finalizable(SnGCMarkStack* finalizable, bool young) {
+	/*
+		Called once marking is done, with the objects that this collection can find dead. Those
+		that are, and still have a free function, are marked after all -- along with everything
+		they reference -- so the free function can run on them intact once the pause is over.
+	*/
+	uintx kept = 0;
+	for (uintx i = 0; i < finalizable->size; ++i) {
+		VALUE object = finalizable->items[i];
+		SnGCHeap* heap = gc_find_heap(object);
+		SnGCAllocInfo* alloc_info;
+		gc_find_object_start(heap, (const byte*)object, &alloc_info);
+		if ((young && !heap->young) || (gc_heap_get_flags(heap, alloc_info->object_index) & GC_MARK)) {
+			finalizable->items[kept++] = object; // alive, or in the nursery of a thread that exited
+		} else {
+			SnGCFreeFunc free_func = gc_finalizer_table_remove(&GC.finalizers.table, object);
+			if (!free_func) continue;
+			gc_mark_value(object, false);
+			gc_mark_stack_push(&GC.finalizers.queue, object);
+			if (GC.finalizers.queued_funcs_capacity < GC.finalizers.queue.capacity) {
+				GC.finalizers.queued_funcs_capacity = GC.finalizers.queue.capacity;
+				GC.finalizers.queued_funcs = (SnGCFreeFunc*)snow_realloc(GC.finalizers.queued_funcs, GC.finalizers.queued_funcs_capacity * sizeof(SnGCFreeFunc));
+			}
+			GC.finalizers.queued_funcs[GC.finalizers.queue.size-1] = free_func;
+		}
+	}
+	finalizable->size = kept;
+	gc_mark_drain_stack();
+	gc_mark_rescan_overflowed();
+}
+
+static void gc_forward_finalizable(SnGCMarkStack* finalizable, SnGCMarkStack* to) {
+	// Points the survivors at their new locations, while the transplanted copies still have their forwarding pointers.
+	for (uintx i = 0; i < finalizable->size; ++i) {
+		VALUE object = finalizable->items[i];
+		SnGCHeap* heap = gc_find_heap(object);
+		SnGCAllocInfo* alloc_info;
+		gc_find_object_start(heap, (const byte*)object, &alloc_info);
+		if (gc_heap_get_flags(heap, alloc_info->object_index) & GC_TRANSPLANTED) {
+			SnGCFreeFunc free_func = gc_finalizer_table_remove(&GC.finalizers.table, object);
+			object = *((VALUE*)object);
+			if (free_func) gc_finalizer_table_set(&GC.finalizers.table, object, free_func);
+		}
+		if (to == finalizable) {
+			finalizable->items[i] = object;
+		} else {
+			gc_mark_stack_push(to, object);
+		}
+	}
+	if (to != finalizable) finalizable->size = 0;
+}
+
+static inline bool gc_found_dead(VALUE value) {
+	// Immediates, and objects in heaps that this collection does not mark, are alive.
+	SnGCHeap* heap = gc_find_heap(value);
+	if (!heap || !gc_is_marking_heap(heap)) return false;
+	SnGCAllocInfo* alloc_info;
+	gc_find_object_start(heap, (const byte*)value, &alloc_info);
+	return !(gc_heap_get_flags(heap, alloc_info->object_index) & GC_MARK);
+}
+
+static void gc_mark_ephemerons() {
+	/*
+		Called once marking is done. The values of live weak maps are marked for the keys that were
+		marked, which can mark more keys, in the same or other maps, until a pass marks nothing new.
+	*/
+	uint32_t survived;
+	do {
+		survived = GC.stats.survived;
+		for (uintx i = 0; i < GC.weak.objects.size; ++i) {
+			SnWeakMap* map = (SnWeakMap*)GC.weak.objects.items[i];
+			if (map->base.type != SN_WEAK_MAP_TYPE || gc_found_dead(map)) continue;
+			for (uintx j = 0; j < map->size; ++j) {
+				if (!gc_found_dead(map->data[j].key) && gc_found_dead(map->data[j].value)) {
+					gc_mark_value(map->data[j].value, false);
 				}
-				case GC_ATOMIC:
-				break; // do nothing; it's atomic.
 			}
 		}
+		gc_mark_drain_stack();
+		gc_mark_rescan_overflowed();
+	} while (GC.stats.survived != survived);
+}
+
+static void gc_clear_weak() {
+	/*
+		Called after gc_mark_ephemerons, and before dead objects with free functions are resurrected,
+		so that nothing can get at those through a weak reference. Weak objects that are dead are
+		cleared too, since a free function may resurrect them.
+	*/
+	for (uintx i = 0; i < GC.weak.objects.size; ++i) {
+		VALUE object = GC.weak.objects.items[i];
+		if (((SnObjectBase*)object)->type == SN_WEAK_REF_TYPE) {
+			SnWeakRef* ref = (SnWeakRef*)object;
+			if (gc_found_dead(ref->target)) ref->target = NULL;
+		} else {
+			SnWeakMap* map = (SnWeakMap*)object;
+			uintx kept = 0;
+			for (uintx j = 0; j < map->size; ++j) {
+				if (gc_found_dead(map->data[j].key) || gc_found_dead(map->data[j].value)) continue;
+				map->data[kept++] = map->data[j];
+			}
+			if (kept < map->size) memset(map->data + kept, 0, (map->size - kept) * sizeof(SnWeakMapEntry));
+			map->size = kept;
+		}
+	}
+}
+
+static void gc_drop_dead_weak() {
+	// Called after dead objects with free functions are resurrected; weak objects still unmarked are garbage.
+	uintx kept = 0;
+	for (uintx i = 0; i < GC.weak.objects.size; ++i) {
+		VALUE object = GC.weak.objects.items[i];
+		if (!gc_found_dead(object)) GC.weak.objects.items[kept++] = object;
+	}
+	GC.weak.objects.size = kept;
+}
+
+static void gc_concurrent_swap_stacks() {
+	SnGCMarkStack tmp = GC.mark_stack;
+	GC.mark_stack = GC.concurrent.gray;
+	GC.concurrent.gray = tmp;
+}
+
+static void gc_concurrent_mark_batch() {
+	GC.collecting_old = true;
+	gc_concurrent_swap_stacks();
+	VALUE value;
+	for (int i = 0; i < GC_CONCURRENT_MARK_BATCH; ++i) {
+		if (!gc_mark_stack_pop(&GC.mark_stack, &value)) {
+			GC.concurrent.done = true;
+			break;
+		}
+		gc_mark_value(value, false);
+	}
+	gc_concurrent_swap_stacks();
+	GC.collecting_old = false;
+}
+
+static void gc_incremental_slice() {
+	// Marks until `gray' runs out or the slice has used up its budget, but always at least one batch.
+	uint64_t start = gc_now_us();
+	do {
+		gc_concurrent_mark_batch();
+	} while (!GC.concurrent.done && gc_now_us() - start < GC.options.slice_budget);
+	
+	uint64_t duration = gc_now_us() - start;
+	++GC.info.num_slices;
+	GC.info.total_slice_time += duration;
+	GC.info.last_slice_time = duration;
+	if (duration > GC.info.max_slice_time) GC.info.max_slice_time = duration;
+}
+
+static void gc_incremental_assist(size_t size) {
+	/*
+		Called by a thread that allocates outside its nursery during an incremental major collection.
+		Every nursery's worth of such allocations runs a slice on the allocating thread; the mutators
+		keep running, just as they do while the concurrent marker thread holds the lock.
+	*/
+	if (__sync_add_and_fetch(&GC.concurrent.allocated, size) < GC_NURSERY_SIZE) return;
+	if (pthread_mutex_trylock(&GC.concurrent.lock)) return; // a collection or another slice is marking
+	if (GC.concurrent.active && !GC.concurrent.done) {
+		GC.concurrent.allocated = 0;
+		gc_incremental_slice();
+	}
+	pthread_mutex_unlock(&GC.concurrent.lock);
+}
+
+static void* gc_concurrent_marker_main(void* unused) {
+	/*
+		Marks old objects in batches, releasing the lock in between, so a collection never waits for
+		more than one batch. Young objects are not marked here, since their threads store into them
+		without barriers; they are promoted and shaded by the next collection instead. When the
+		gray stack is empty, the next collection finishes the major collection. Overflow is left to
+		the rescan in the final pause, because the heaps cannot be walked while the mutators run.
+	*/
+	pthread_mutex_lock(&GC.concurrent.lock);
+	for (;;) {
+		while (!GC.concurrent.active || GC.concurrent.done) {
+			pthread_cond_wait(&GC.concurrent.wakeup, &GC.concurrent.lock);
+		}
+		
+		gc_concurrent_mark_batch();
+		pthread_mutex_unlock(&GC.concurrent.lock);
+		sched_yield();
+		pthread_mutex_lock(&GC.concurrent.lock);
+	}
+	return NULL;
+}
+
+static void gc_mark_root_definite(VALUE* root_p, bool on_stack) {
+	// The stacks will have changed by the final pause, which sets GC_INDEFINITE on what is still there.
+	gc_mark_value(*root_p, false);
+}
+
+static void gc_begin_concurrent_major() {
+	/*
+		The initial pause, right after a minor collection has emptied the nurseries: mark the roots,
+		and leave their children to the marker thread, or to incremental slices.
+	*/
+	DTRACE_PROBE(GC_MAJOR());
+	gc_begin_phase(&GC.statistics.phase_time.mark);
+	gc_clear_flags();
+	gc_concurrent_swap_stacks();
+	gc_with_everything_do(gc_mark_root_definite);
+	gc_concurrent_swap_stacks();
+	
+	GC.concurrent.active = true;
+	GC.concurrent.done = false;
+	GC.concurrent.marking = true;
+	GC.concurrent.allocated = 0;
+	
+	if (GC.options.concurrent_major && !GC.concurrent.started) {
+		int r = pthread_create(&GC.concurrent.thread, NULL, gc_concurrent_marker_main, NULL);
+		ASSERT(r == 0); // could not start GC marker thread
+		pthread_detach(GC.concurrent.thread);
+		GC.concurrent.started = true;
+	}
+}
+
+static void gc_concurrent_drain_barrier_buffer(SnGCMarkStack* buffer) {
+	// Young references are dropped; the minor collection finds the live ones, and shades them.
+	VALUE value;
+	while (gc_mark_stack_pop(buffer, &value)) {
+		SnGCHeap* heap = gc_lookup_heap(value);
+		if (heap && !heap->young && !gc_mark_stack_push(&GC.mark_stack, value)) {
+			gc_mark_overflowed(value);
+		}
 	}
 }
 
+static void gc_concurrent_shade_dirty_allocation(SnGCHeap* heap, byte* allocation, void* userdata) {
+	SnGCAllocInfo* alloc_info = &((SnGCObjectHead*)allocation)->alloc_info;
+	if (alloc_info->alloc_type == GC_INVALID) return;
+	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
+	if (!(flags & GC_MARK) || (flags & GC_TRANSPLANTED)) return; // will be scanned when marked, or moved
+	byte* object = allocation + sizeof(SnGCObjectHead);
+	gc_scan_object(object, alloc_info, gc_mark_push);
+}
+
+static void gc_concurrent_shade_dirty_cards(SnGCHeap* heap, void* userdata) {
+	gc_heap_with_dirty_objects_do(heap, gc_concurrent_shade_dirty_allocation, NULL);
+}
+
+static void gc_concurrent_minor() {
+	/*
+		A collection while the marker is running. Everything that could have been hidden from the
+		marker is made gray: the references recorded by the write barrier, the objects promoted by
+		this minor collection, and the children of marked objects with dirty cards -- which includes
+		big objects, whose first stores are never seen by the barrier.
+	*/
+	gc_begin_phase(&GC.statistics.phase_time.mark);
+	gc_concurrent_swap_stacks();
+	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
+		gc_concurrent_drain_barrier_buffer(&nursery->barrier_buffer);
+	}
+	pthread_mutex_lock(&GC.nursery_lock);
+	gc_concurrent_drain_barrier_buffer(&GC.concurrent.orphaned);
+	pthread_mutex_unlock(&GC.nursery_lock);
+	gc_concurrent_swap_stacks();
+	
+	gc_minor();
+	
+	gc_concurrent_swap_stacks();
+	gc_with_each_old_heap_do(gc_concurrent_shade_dirty_cards, NULL);
+	gc_concurrent_swap_stacks();
+	
+	// overflowed objects are only rescanned by the final pause
+	if (GC.concurrent.gray.overflowed) GC.concurrent.done = true;
+	if (GC.concurrent.gray.size) GC.concurrent.done = false;
+}
+
+static void gc_concurrent_shade_promoted() {
+	// Promoted objects are unmarked, so pushing them has the marker scan them.
+	gc_concurrent_swap_stacks();
+	for (uintx i = 0; i < GC.promoted.size; ++i) {
+		if (!gc_mark_stack_push(&GC.mark_stack, GC.promoted.items[i])) {
+			gc_mark_overflowed(GC.promoted.items[i]);
+		}
+	}
+	gc_concurrent_swap_stacks();
+}
+
+static void gc_finish_concurrent_major() {
+	/*
+		The final pause, after gc_concurrent_minor: finish marking from what is left gray, mark the
+		roots again, and sweep. Fragmented heaps are not evacuated, since fixing the references to
+		the moved objects would trace the whole heap in the pause.
+	*/
+	GC.concurrent.marking = false;
+	GC.concurrent.active = false;
+	GC.concurrent.done = false;
+	
+	gc_begin_phase(&GC.statistics.phase_time.mark);
+	gc_concurrent_swap_stacks();
+	gc_mark_drain_stack();
+	gc_mark_everything();
+	gc_mark_ephemerons();
+	gc_clear_weak();
+	gc_decide_samples(true);
+	gc_queue_dead_finalizable(&GC.finalizers.old, false);
+	gc_drop_dead_weak();
+	
+	gc_major_sweep(false);
+}
+
 void gc_update_root(VALUE* root_p, bool on_stack) {
+	/*
+		Updates the reference at root_p if it points to a transplanted object, and pushes the
+		referenced object on the mark stack to have its own references updated, unless that has
+		already happened.
+	*/
 	SnGCHeap* heap = gc_find_heap(*root_p);
 	if (heap) {
 		SnGCAllocInfo* alloc_info;
-		SnGCMetaInfo* meta;
-		byte* object = gc_find_object_start(heap, (const byte*)*root_p, &alloc_info, &meta);
+		byte* object = gc_find_object_start(heap, (const byte*)*root_p, &alloc_info);
 		
 		ASSERT(on_stack || (alloc_info->alloc_type != GC_INVALID)); // stale pointer in non-stack memory?
 		
@@ -816,34 +2693,372 @@ void gc_update_root(VALUE* root_p, bool on_stack) {
 			*root_p = (VALUE)(object + diff);
 			
 			heap = gc_find_heap(*root_p);
-			gc_find_object_start(heap, object, &alloc_info, &meta);
+			gc_find_object_start(heap, object, &alloc_info);
+			flags = gc_heap_get_flags(heap, alloc_info->object_index);
 		}
 		
 		if (flags & GC_UPDATED) return;
 		gc_heap_set_flags(heap, alloc_info->object_index, GC_UPDATED);
+		if (alloc_info->alloc_type == GC_ATOMIC) return;
 		
-		switch (alloc_info->alloc_type) {
-			case GC_OBJECT:
-			{
-				gc_with_object_do(object, alloc_info, meta, gc_update_root);
-				break;
-			}
-			case GC_BLOB:
-			{
-				VALUE* blob = (VALUE*)object;
-				for (size_t i = 0; i < alloc_info->size / sizeof(VALUE); ++i) {
-					gc_update_root(blob + i, false);
-				}
-				break;
-			}
-			case GC_ATOMIC:
-			break; // do nothing; it's atomic
+		gc_prefetch_allocation(object);
+		if (!gc_mark_stack_push(&GC.mark_stack, object)) {
+			gc_heap_set_flags(heap, alloc_info->object_index, GC_OVERFLOWED);
 		}
 	}
 }
 
+static void gc_update_drain_stack() {
+	VALUE object;
+	while (gc_mark_stack_pop(&GC.mark_stack, &object)) {
+		SnGCHeap* heap = gc_find_heap(object);
+		SnGCAllocInfo* alloc_info;
+		gc_find_object_start(heap, (const byte*)object, &alloc_info);
+		gc_scan_object(object, alloc_info, gc_update_root);
+	}
+}
+
+static void gc_rescan_overflowed_for_update(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, void* userdata) {
+	if (alloc_info->alloc_type == GC_INVALID) return;
+	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
+	if ((flags & (GC_UPDATED | GC_OVERFLOWED)) == (GC_UPDATED | GC_OVERFLOWED)) {
+		gc_heap_unset_flags(heap, alloc_info->object_index, GC_OVERFLOWED);
+		gc_scan_object(object, alloc_info, gc_update_root);
+		gc_update_drain_stack();
+	}
+}
+
+static void gc_update_everything() {
+	gc_with_everything_do(gc_update_root);
+	gc_with_weak_do(gc_update_root);
+	gc_update_drain_stack();
+	while (GC.mark_stack.overflowed) {
+		GC.mark_stack.overflowed = false;
+		void* action;
+		CAST_FUNCTION_TO_DATA(action, gc_rescan_overflowed_for_update);
+		gc_with_each_heap_do(gc_rescan_heap, action);
+	}
+}
+
+static void gc_fix_reference(VALUE* root_p, bool on_stack) {
+	// Points a reference to a transplanted nursery object at its new location.
+	SnGCHeap* heap = gc_find_heap(*root_p);
+	if (!heap || !heap->young) return;
+	SnGCAllocInfo* alloc_info;
+	byte* object = gc_find_object_start(heap, (const byte*)*root_p, &alloc_info);
+	if (gc_heap_get_flags(heap, alloc_info->object_index) & GC_TRANSPLANTED) {
+		ASSERT(!on_stack); // an indefinite pointer was transplanted!
+		size_t diff = ((byte*)*root_p) - object;
+		*root_p = (VALUE)(*((byte**)object) + diff);
+	}
+}
+
+static void gc_fix_pinned_object(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, void* userdata) {
+	if (alloc_info->alloc_type == GC_INVALID) return;
+	SnGCFlags flags = gc_heap_get_flags(heap, alloc_info->object_index);
+	if ((flags & (GC_MARK | GC_TRANSPLANTED)) == GC_MARK) {
+		gc_scan_object(object, alloc_info, gc_fix_reference);
+	}
+}
+
+static void gc_update_young() {
+	/*
+		After a generational minor collection, references to transplanted objects can only be in the
+		roots, in dirty cards, in the transplanted objects themselves, and in the nursery objects that
+		had to stay. No tracing is necessary; just fix up those references.
+	*/
+	gc_with_everything_do(gc_fix_reference);
+	gc_with_dirty_cards_do(gc_fix_reference);
+	gc_with_weak_do(gc_fix_reference);
+	
+	for (uintx i = 0; i < GC.promoted.size; ++i) {
+		VALUE object = GC.promoted.items[i];
+		SnGCHeap* heap = gc_find_heap(object);
+		SnGCAllocInfo* alloc_info;
+		gc_find_object_start(heap, (const byte*)object, &alloc_info);
+		gc_scan_object(object, alloc_info, gc_fix_reference);
+	}
+	
+	for (SnGCNursery* nursery = GC.nursery_head; nursery != NULL; nursery = nursery->next) {
+		if (nursery->heap.num_indefinite > 0) {
+			gc_with_each_object_in_heap_do(&nursery->heap, gc_fix_pinned_object, NULL);
+		}
+	}
+}
+
+static const char* gc_type_name(const byte* object, const SnGCAllocInfo* alloc_info, char buffer[16]) {
+	// The name of the class of an object, or of the kind of allocation. `buffer' is used for unknown types.
+	if (alloc_info->alloc_type == GC_BLOB) return "blob";
+	if (alloc_info->alloc_type == GC_ATOMIC) return "atomic";
+	// an object that is still being initialized may not have its type yet
+	SnObjectType type = ((const SnObjectBase*)object)->type;
+	SnClass* klass = type < SN_TYPE_MAX ? snow_get_class(type) : NULL;
+	if (klass) return snow_symbol_to_cstr(klass->name);
+	snprintf(buffer, 16, "0x%x", type);
+	return buffer;
+}
+
+static void gc_stop_the_world() {
+	// For inspecting the heap outside of collections. Waits for the collection taking place, if any.
+	if (pthread_mutex_trylock(&GC.gc_lock)) {
+		snow_gc_barrier_enter();
+		pthread_mutex_lock(&GC.gc_lock);
+		snow_gc_barrier_leave();
+	}
+	_snow_gc_safepoint_requested = 1;
+	snow_set_gc_barriers();
+	snow_task_pause();
+	_snow_gc_is_collecting = true;
+}
+
+static void gc_restart_the_world() {
+	_snow_gc_is_collecting = false;
+	_snow_gc_safepoint_requested = 0;
+	pthread_mutex_unlock(&GC.gc_lock);
+	snow_unset_gc_barriers();
+	snow_task_resume();
+}
+
+static byte* gc_dump_find_object(VALUE value) {
+	// the allocation that `value' points into, or NULL
+	SnGCHeap* heap = gc_find_heap(value);
+	if (!heap) return NULL;
+	SnGCAllocInfo* alloc_info;
+	byte* object = gc_find_object_start(heap, (const byte*)value, &alloc_info);
+	return alloc_info->alloc_type == GC_INVALID ? NULL : object;
+}
+
+static void gc_dump_root(const char* kind, const char* name, VALUE value) {
+	byte* object = gc_dump_find_object(value);
+	if (object) fprintf(gc_dump_file, "root %s %s %p\n", kind, name, object);
+}
+
+static void gc_dump_child(VALUE* root_p, bool on_stack) {
+	byte* object = gc_dump_find_object(*root_p);
+	if (object) fprintf(gc_dump_file, " %p", object);
+}
+
+static void gc_dump_stack_root(VALUE* root_p, bool on_stack) {
+	gc_dump_root("stack", "-", *root_p);
+}
+
+static void gc_dump_runtime_root(VALUE* root_p, bool on_stack) {
+	gc_dump_root("runtime", "-", *root_p);
+}
+
+static void gc_dump_object(SnGCHeap* heap, byte* object, SnGCAllocInfo* alloc_info, void* userdata) {
+	if (alloc_info->alloc_type == GC_INVALID) return;
+	if (gc_heap_get_flags(heap, alloc_info->object_index) & GC_TRANSPLANTED) return;
+	
+	char type[16];
+	fprintf(gc_dump_file, "object %p %s %lu", object, gc_type_name(object, alloc_info, type), (unsigned long)gc_calculate_total_size(alloc_info->size));
+	gc_scan_object(object, alloc_info, gc_dump_child);
+	fputc('\n', gc_dump_file);
+}
+
+static void gc_dump_heap(SnGCHeap* heap, void* userdata) {
+	gc_with_each_object_in_heap_do(heap, gc_dump_object, NULL);
+}
+
+static void gc_dump_task_stack(SnTask* task, void* userdata) {
+	gc_with_task_stack_do(task, gc_dump_stack_root);
+}
+
+bool snow_gc_dump_heap(const char* path) {
+	/*
+		Writes one line per root and per object, straight to the file:
+		
+			snow-heap 1
+			root <global|store|runtime|stack> <name, store key, or -> <address>
+			object <address> <type> <bytes> <referenced address>...
+		
+		Addresses are those of the allocations, and sizes include their headers. The world is
+		stopped while the heap is walked, as for a collection.
+	*/
+	FILE* file = fopen(path, "w");
+	if (!file) return false;
+	
+	gc_stop_the_world();
+	pthread_mutex_lock(&GC.sweeper.lock);
+	pthread_mutex_lock(&GC.concurrent.lock);
+	gc_finish_sweeping(); // so the garbage of the last major collection is not dumped
+	
+	gc_dump_file = file;
+	fputs("snow-heap 1\n", file);
+	
+	// the named roots first, so they can be told apart from the runtime roots that also reach them
+	SnContext* global = snow_global_context();
+	if (global->local_names && global->locals) {
+		for (intx i = 0; i < snow_array_size(global->locals) && i < snow_array_size(global->local_names); ++i) {
+			const char* name = snow_symbol_to_cstr(value_to_symbol(snow_array_get(global->local_names, i)));
+			gc_dump_root("global", name, snow_array_get(global->locals, i));
+		}
+	}
+	SnArray* store = *_snow_store_ptr();
+	for (intx i = 0; i < snow_array_size(store); ++i) {
+		char key[32];
+		snprintf(key, sizeof(key), "%ld", (long)i);
+		gc_dump_root("store", key, snow_array_get(store, i));
+	}
+	gc_with_definite_roots_do(gc_dump_runtime_root);
+	snow_with_each_task_do(gc_dump_task_stack, NULL);
+	
+	gc_with_each_heap_do(gc_dump_heap, NULL);
+	gc_dump_file = NULL;
+	
+	pthread_mutex_unlock(&GC.concurrent.lock);
+	pthread_mutex_unlock(&GC.sweeper.lock);
+	gc_restart_the_world();
+	
+	bool ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+void snow_gc_set_sample_interval(uintx bytes) {
+	GC.sampler.interval = bytes;
+	_snow_gc_is_sampling = bytes != 0;
+}
+
+void snow_gc_sampler_enter(VALUE function, const void* frame) {
+	SnGCSamplerStack* stack = &(gc_current_nursery ? gc_current_nursery : add_nursery())->calls;
+	gc_sampler_stack_unwind(stack, frame);
+	if (stack->size < GC_SAMPLER_MAX_DEPTH) {
+		stack->calls[stack->size].function = function;
+		stack->calls[stack->size].frame = frame;
+		++stack->size;
+	}
+}
+
+void snow_gc_sampler_leave(const void* frame) {
+	if (gc_current_nursery) gc_sampler_stack_unwind(&gc_current_nursery->calls, frame);
+}
+
+static const char* gc_sampler_function_name(SnFunction* function) {
+	// Functions compiled from Snow are unnamed, so look for a variable holding them where they were defined.
+	const char* name = snow_symbol_to_cstr(function->desc->name);
+	if (strcmp(name, "<unnamed>") != 0) return name;
+	for (SnContext* context = function->declaration_context; context != NULL; context = context->static_parent) {
+		if (!context->local_names || !context->locals) continue;
+		for (intx i = 0; i < snow_array_size(context->locals) && i < snow_array_size(context->local_names); ++i) {
+			if (snow_array_get(context->locals, i) == function)
+				return snow_symbol_to_cstr(value_to_symbol(snow_array_get(context->local_names, i)));
+		}
+	}
+	return name;
+}
+
+static void gc_sample_allocation(byte* object, size_t size) {
+	// The slow path of gc_alloc while sampling, when the countdown has run out.
+	uintx interval = GC.sampler.interval;
+	if (!interval) return;
+	bool first = gc_sample_seed == 0;
+	if (first) gc_sample_seed = ((uint32_t)(uintx)&gc_sample_countdown ^ (uint32_t)gc_now_us()) | 1;
+	
+	// xorshift; randomized intervals keep the samples from lining up with patterns in the allocations
+	gc_sample_seed ^= gc_sample_seed << 13;
+	gc_sample_seed ^= gc_sample_seed >> 17;
+	gc_sample_seed ^= gc_sample_seed << 5;
+	gc_sample_countdown = interval / 2 + gc_sample_seed % interval;
+	if (first) return; // the countdown started at 0, rather than somewhere in an interval
+	
+	// the names may not contain the separators of the folded format
+	char stack[0x1000];
+	size_t length = 0;
+	SnGCSamplerStack* calls = &(gc_current_nursery ? gc_current_nursery : add_nursery())->calls;
+	for (uintx i = 0; i < calls->size && length < sizeof(stack) - 2; ++i) {
+		for (const char* c = gc_sampler_function_name((SnFunction*)calls->calls[i].function); *c && length < sizeof(stack) - 2; ++c) {
+			stack[length++] = (*c == ';' || *c == '\n') ? '_' : *c;
+		}
+		stack[length++] = ';';
+	}
+	stack[length] = '\0';
+	
+	pthread_mutex_lock(&GC.sampler.lock);
+	if (GC.sampler.num_pending == GC.sampler.pending_capacity) {
+		GC.sampler.pending_capacity = GC.sampler.pending_capacity ? GC.sampler.pending_capacity * 2 : 64;
+		GC.sampler.pending = (SnGCSample*)snow_realloc(GC.sampler.pending, GC.sampler.pending_capacity * sizeof(SnGCSample));
+	}
+	SnGCSample* sample = &GC.sampler.pending[GC.sampler.num_pending++];
+	sample->object = object;
+	sample->stack = (char*)snow_malloc(length + 1);
+	memcpy(sample->stack, stack, length + 1);
+	// an allocation of `size' bytes is sampled with a probability of about size/interval
+	sample->bytes = size > interval ? size : interval;
+	pthread_mutex_unlock(&GC.sampler.lock);
+}
+
+static void gc_add_sample(SnGCSampleTable* table, const SnGCSample* sample, const char* fate) {
+	SnGCHeap* heap = gc_find_heap(sample->object);
+	ASSERT(heap); // sampled object was freed before being decided on?
+	SnGCAllocInfo* alloc_info;
+	byte* object = gc_find_object_start(heap, sample->object, &alloc_info);
+	char type[16];
+	char stack[0x1100];
+	snprintf(stack, sizeof(stack), "%s%s (%s)", sample->stack, gc_type_name(object, alloc_info, type), fate);
+	gc_sample_table_add(table, stack, sample->bytes);
+}
+
+static void gc_decide_samples(bool all) {
+	/*
+		Called when marking is done, before dead objects with free functions are resurrected. The
+		samples of objects that this collection has either marked or found dead are added to the
+		profile. Samples of old objects wait for a major collection, unless `all' is set.
+	*/
+	pthread_mutex_lock(&GC.sampler.lock);
+	uintx num_kept = 0;
+	for (uintx i = 0; i < GC.sampler.num_pending; ++i) {
+		SnGCSample* sample = &GC.sampler.pending[i];
+		SnGCHeap* heap = gc_find_heap(sample->object);
+		if (!all && !heap->young) {
+			GC.sampler.pending[num_kept++] = *sample;
+			continue;
+		}
+		SnGCAllocInfo* alloc_info;
+		gc_find_object_start(heap, sample->object, &alloc_info);
+		bool survived = (gc_heap_get_flags(heap, alloc_info->object_index) & GC_MARK) != 0;
+		gc_add_sample(&GC.sampler.profile, sample, survived ? "survived" : "died");
+		snow_free(sample->stack);
+	}
+	GC.sampler.num_pending = num_kept;
+	pthread_mutex_unlock(&GC.sampler.lock);
+}
+
+static void gc_write_sample_table(FILE* file, const SnGCSampleTable* table) {
+	for (uintx i = 0; i < table->capacity; ++i) {
+		const SnGCSampleRecord* record = &table->records[i];
+		if (record->stack) fprintf(file, "%s %llu\n", record->stack, (unsigned long long)record->bytes);
+	}
+}
+
+bool snow_gc_write_alloc_profile(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file) return false;
+	
+	// the world is stopped to look at the objects of the samples that are still pending
+	SnGCSampleTable pending = { NULL, 0, 0 };
+	gc_stop_the_world();
+	pthread_mutex_lock(&GC.sampler.lock);
+	for (uintx i = 0; i < GC.sampler.num_pending; ++i) {
+		gc_add_sample(&pending, &GC.sampler.pending[i], "pending");
+	}
+	gc_write_sample_table(file, &GC.sampler.profile);
+	pthread_mutex_unlock(&GC.sampler.lock);
+	gc_restart_the_world();
+	gc_write_sample_table(file, &pending);
+	gc_sample_table_clear(&pending);
+	
+	bool ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+static void gc_write_alloc_profile_at_exit() {
+	if (!snow_gc_write_alloc_profile(GC.sampler.profile_path))
+		warn("Could not write allocation profile to %s.\n", GC.sampler.profile_path);
+}
+
 bool gc_looks_like_allocation(const byte* ptr) {
 	const SnGCObjectHead* head = (SnGCObjectHead*)ptr;
+	#if GC_BEADS
 	const byte* data = ptr + sizeof(SnGCObjectHead);
 	const byte* data_end = data + head->alloc_info.size;
 	const SnGCObjectTail* tail = (SnGCObjectTail*)data_end;
@@ -852,19 +3067,16 @@ bool gc_looks_like_allocation(const byte* ptr) {
 	    && gc_check_checksum(&head->alloc_info)
 	    && gc_maybe_contains((const void*)data_end) // mostly necessary to avoid crashes on false positives, when checking for bead 2.
 	    && tail->bead == MAGIC_BEAD_TAIL;
+	#else
+	return gc_check_checksum(&head->alloc_info);
+	#endif
 }
 
-static inline byte* gc_find_object_start(const SnGCHeap* heap, const byte* data, SnGCAllocInfo** alloc_info_p, SnGCMetaInfo** meta_p) {
-	const byte* ptr = data;
-	ptr -= (uintx)ptr % SNOW_GC_ALIGNMENT;
-	while (gc_heap_contains(heap, ptr) && !gc_looks_like_allocation(ptr))
-	{
-		ptr -= SNOW_GC_ALIGNMENT;
-		ASSERT(gc_maybe_contains(ptr));
-	}
+static inline byte* gc_find_object_start(const SnGCHeap* heap, const byte* data, SnGCAllocInfo** alloc_info_p) {
+	const byte* ptr = gc_heap_find_allocation(heap, data);
+	ASSERT(gc_looks_like_allocation(ptr));
 	const byte* object_start = ptr + sizeof(SnGCObjectHead);
 	*alloc_info_p = &((SnGCObjectHead*)ptr)->alloc_info;
-	*meta_p = &((SnGCObjectTail*)(object_start + (*alloc_info_p)->size))->meta_info;
 	return (byte*)object_start;
 }
 
@@ -30,6 +30,14 @@ CAPI void snow_init_gc();
 */
 CAPI SnObjectBase* snow_gc_alloc_object(uintx size) ATTR_ALLOC_SIZE(1);
 
+/*
+	snow_gc_alloc_object_at: Like snow_gc_alloc_object, for an object allocated from the code at
+	`site'. The survival of the objects of each site is measured, and the sites whose objects nearly
+	always survive are pretenured: their objects are allocated straight into the old generation,
+	instead of being copied out of a nursery. snow_alloc_any_object passes its return address.
+*/
+CAPI SnObjectBase* snow_gc_alloc_object_at(uintx size, const void* site) ATTR_ALLOC_SIZE(1);
+
 /*
 	snow_gc_alloc_blob: allocates memory that doesn't contain a specific struct, but can contain roots.
 	During GC, the memory will be conservatively scanned for roots. This is mostly useful for various
@@ -46,16 +54,50 @@ CAPI void* snow_gc_alloc_atomic(uintx size) ATTR_ALLOC_SIZE(1);
 
 /*
 	snow_gc_realloc: Reallocates memory that is already GC-allocated. The semantics are the same as the
-	system-provided realloc(3).
+	system-provided realloc(3), except that `ptr' must not be NULL, and that shrinking leaves the
+	allocation as it is. The contents are kept, and so is the free function. If `ptr' is the most
+	recent allocation of the calling thread, it grows in place; otherwise the old allocation is left
+	for the GC.
 */
-CAPI void* snow_gc_realloc(void* ptr, uintx size) ATTR_ALLOC_SIZE(1);
+CAPI void* snow_gc_realloc(void* ptr, uintx size) ATTR_ALLOC_SIZE(2);
+
+/*
+	snow_gc_realloc_hint: Like snow_gc_realloc, but makes room for `hint' bytes if it can, so that
+	growing up to that later needs no new allocation. Use snow_gc_allocated_size to find out how much
+	room there is.
+*/
+CAPI void* snow_gc_realloc_hint(void* ptr, uintx size, uintx hint) ATTR_ALLOC_SIZE(2);
 
 /*
 	snow_gc_set_free_func: sets a finalizer function for the given pointer, which will be called when
-	the memory pointed to by that pointer is garbage collected.
+	the memory pointed to by that pointer is garbage collected. It runs after the collection that found
+	the object dead, on the thread that triggered it, and the object and everything it references are
+	kept intact until then.
 */
 CAPI void snow_gc_set_free_func(const void* data, SnGCFreeFunc);
 
+/*
+	snow_gc_add_weak: Registers a WeakRef or WeakMap with the GC, which clears its references to
+	objects that were collected. Done by the constructors in weak.c; objects with a free function
+	are found dead before it runs, so weak references never see them resurrected.
+*/
+CAPI void snow_gc_add_weak(VALUE object);
+
+/*
+	snow_gc_run_finalizers: Runs the free functions of all objects found dead so far. snow_gc() calls
+	this once the world is running again, so it's mostly useful for waiting on finalizers in tests.
+*/
+CAPI void snow_gc_run_finalizers();
+
+/*
+	snow_gc_write_barrier: Records that `value' was stored into a GC-allocated object, so that minor
+	collections can find references from old objects to young ones without tracing the whole heap.
+	Call it after any store of a VALUE into an object that may have survived a collection -- which is
+	any object that was allocated before the most recent allocation. `slot' is the address written to,
+	or any address within the same allocation (e.g. the owning object, for slots in side tables).
+*/
+CAPI void snow_gc_write_barrier(const void* slot, const void* value);
+
 /*
 	snow_gc: Force GC invocation.
 */
@@ -67,16 +109,141 @@ CAPI void snow_gc();
 */
 CAPI uintx snow_gc_allocated_size(const void* data);
 
+#define SNOW_GC_PAUSE_HISTOGRAM_SIZE 16
+
+typedef struct SnGCPhaseTimes {
+	// microseconds
+	uint64_t mark;
+	uint64_t sweep;
+	uint64_t update;
+	uint64_t finalize; // free functions, which run once the pause is over
+} SnGCPhaseTimes;
+
+typedef struct SnGCStatistics {
+	uint64_t num_collections;
+	uint64_t num_major_collections; // including concurrent and incremental ones, counted by their final pause
+
+	uint64_t total_pause_time; // microseconds
+	uint64_t last_pause_time;
+	uint64_t max_pause_time;
+	uint64_t total_time_to_safepoint; // from asking the other threads to stop until the last one has, included in the pause times
+	uint64_t last_time_to_safepoint;
+	uint64_t max_time_to_safepoint;
+	uint64_t num_slices; // of incremental major collections, which run between the pauses
+	uint64_t total_slice_time; // microseconds; only the slices run by minor collections are in the pause times
+	uint64_t last_slice_time;
+	uint64_t max_slice_time;
+	SnGCPhaseTimes total_phase_time;
+	SnGCPhaseTimes last_phase_time;
+	uint64_t pause_histogram[SNOW_GC_PAUSE_HISTOGRAM_SIZE]; // bucket i counts pauses shorter than 64<<i microseconds, the last one all longer ones too
+
+	uint64_t bytes_allocated; // in nurseries and big allocations, including headers
+	uint64_t bytes_promoted; // out of nurseries
+	uint64_t bytes_pretenured; // allocated in the old generation by pretenured sites, and included in bytes_allocated
+	uint64_t bytes_survived; // promoted, or pinned in their nurseries
+	uint64_t last_bytes_allocated;
+	uint64_t last_bytes_survived;
+	double survival_rate; // bytes_survived / the bytes allocated in nurseries
+	double last_survival_rate;
+
+	// bytes used in each space at the end of the last collection
+	uintx nursery_size;
+	uintx adult_size;
+	uintx size_class_size;
+	uintx big_size;
+	uintx unkillable_size;
+	uintx pinned_size; // of the objects in unkillable heaps
+	uintx total_mem_usage; // of all chunks, used or not
+	uintx num_pretenured_sites;
+} SnGCStatistics;
+
+/*
+	snow_gc_get_stats: Copies the collection statistics so far into `stats'. The heap sizes are those
+	of the end of the last collection; everything else is cumulative, or of the last collection.
+*/
+CAPI void snow_gc_get_stats(SnGCStatistics* stats);
+
+typedef struct SnGCAllocationSite {
+	const void* address; // the return address of the call to snow_alloc_any_object
+	uint32_t num_tenured; // objects allocated there since it was first pretenured, roughly
+} SnGCAllocationSite;
+
+/*
+	snow_gc_get_pretenured_sites: Copies up to `max' of the allocation sites that are pretenured at
+	the moment into `sites', and returns how many there are. A site is demoted again once fewer than
+	half of the objects that it still allocates in a nursery survive. SNOW_GC_PRETENURE=0 turns
+	pretenuring off, and so does SNOW_GC_MAJOR=copying.
+*/
+CAPI uintx snow_gc_get_pretenured_sites(SnGCAllocationSite* sites, uintx max);
+
+/*
+	snow_gc_dump_heap: Writes every root and allocation, with the allocations they reference, to the
+	file at `path', while the world is stopped. The file is written as the heap is walked, so it takes
+	no memory to speak of. heapsummary.rb in the source tree summarizes it. Returns false if the file
+	could not be written.
+*/
+CAPI bool snow_gc_dump_heap(const char* path);
+
+/*
+	snow_gc_set_sample_interval: Samples about one allocation per `bytes' bytes allocated, along with
+	the Snow functions being called, and whether the object survived the collection after it. 0 stops
+	sampling. SNOW_GC_SAMPLE_INTERVAL sets it at startup, and SNOW_GC_ALLOC_PROFILE=<path> samples
+	every 512 KiB if it's not set, and writes the profile to the file when the process exits.
+*/
+CAPI void snow_gc_set_sample_interval(uintx bytes);
+
+/*
+	snow_gc_write_alloc_profile: Writes the samples so far as folded stacks, the input format of
+	flamegraph.pl, with the type of the object and whether it survived as the innermost frame:
+
+		outer;inner;Array (survived) 1048576
+
+	Counts are estimated bytes allocated. Returns false if the file could not be written.
+*/
+CAPI bool snow_gc_write_alloc_profile(const char* path);
+
+/*
+	snow_gc_sampler_enter, snow_gc_sampler_leave: Called by snow_function_call around the call of
+	`function' while snow_gc_is_sampling(), from its stack frame `frame'.
+*/
+CAPI void snow_gc_sampler_enter(VALUE function, const void* frame);
+CAPI void snow_gc_sampler_leave(const void* frame);
+
+extern volatile bool _snow_gc_is_sampling;
+static inline bool snow_gc_is_sampling() { return _snow_gc_is_sampling; }
+
+typedef struct SnGCCallSite {
+	uint32_t return_offset; // from the start of the code
+	uint64_t live_slots; // bit i is set if the word at (frame pointer - (i+1)*sizeof(VALUE)) holds a reference
+} SnGCCallSite;
+
+/*
+	snow_gc_register_stack_map: Describes the frames of a piece of generated code, so the GC can find
+	the references in them precisely. `frame_size' is the number of bytes between the frame pointer
+	and the stack pointer at every call, and `sites' lists the calls in order of return address. Live
+	slots must hold a valid reference or a non-pointer value; what they reference may be moved, and
+	the slots updated. All other words of the frame are still scanned conservatively.
+*/
+CAPI void snow_gc_register_stack_map(const void* code, uintx code_size, uintx frame_size, const SnGCCallSite* sites, uintx num_sites);
+
 extern volatile bool _snow_gc_is_collecting;
 static inline bool snow_gc_is_collecting() { return _snow_gc_is_collecting; }
 
+/*
+	The poll word is set from the moment a collection starts stopping the world until it restarts it,
+	and every thread must reach a GC barrier in the meantime. It is a whole word so that generated
+	code can compare it to zero with a single instruction.
+*/
+extern volatile uintx _snow_gc_safepoint_requested;
+static inline bool snow_gc_safepoint_requested() { return _snow_gc_safepoint_requested != 0; }
+
 /*
 	snow_gc_barrier: Insert GC barrier, which gives the GC a chance to temporarily stop the thread
 	while performing a collection. Insert calls to this function in busy loops and functions that
 	are called extraordinarily often to allow maximum parallellism.
 */
 static inline void snow_gc_barrier() {
-	if (snow_gc_is_collecting()) {
+	if (snow_gc_safepoint_requested()) {
 		SnExecutionState state;
 		if (snow_save_execution_state(&state))
 			return;
@@ -86,6 +253,12 @@ static inline void snow_gc_barrier() {
 	}
 }
 
+/*
+	snow_gc_safepoint: The out-of-line snow_gc_barrier, which generated code calls when it finds the
+	poll word set, at the start of every function and on every loop back-edge.
+*/
+CAPI void snow_gc_safepoint();
+
 // Snow Malloc Interface
 CAPI void* snow_malloc(uintx size)                                             ATTR_ALLOC_SIZE(1);
 CAPI void* snow_calloc(uintx count, uintx size)                                ATTR_ALLOC_SIZE(2);
@@ -0,0 +1,95 @@
+#ifndef GCFINALIZERS_H_J5DW0T8E
+#define GCFINALIZERS_H_J5DW0T8E
+
+/*
+	The free functions of objects, in a table on the side, so that allocations don't need room for
+	one. Only objects with a free function have an entry, which the collector moves along with the
+	object. Open addressing with linear probing; removing an entry shifts the ones after it back
+	into place, so there are no tombstones.
+*/
+
+typedef struct SnGCFinalizerEntry {
+	const void* object; // NULL for an empty slot
+	SnGCFreeFunc free_func;
+} SnGCFinalizerEntry;
+
+typedef struct SnGCFinalizerTable {
+	SnGCFinalizerEntry* entries;
+	uintx size;
+	uintx capacity; // a power of two
+} SnGCFinalizerTable;
+
+#define GC_FINALIZER_TABLE_INITIAL_CAPACITY 64
+
+static inline uintx gc_finalizer_table_home(const SnGCFinalizerTable* table, const void* object) {
+	// objects are 16-byte aligned, so the low bits carry nothing
+	uint64_t hash = ((uint64_t)(uintx)object >> 4) * 0x9e3779b97f4a7c15ULL;
+	return (uintx)(hash >> 32) & (table->capacity - 1);
+}
+
+static inline SnGCFinalizerEntry* gc_finalizer_table_find(const SnGCFinalizerTable* table, const void* object) {
+	// Returns the entry of `object', or the empty slot where it belongs.
+	for (uintx i = gc_finalizer_table_home(table, object);; i = (i + 1) & (table->capacity - 1)) {
+		SnGCFinalizerEntry* entry = &table->entries[i];
+		if (!entry->object || entry->object == object) return entry;
+	}
+}
+
+static inline SnGCFreeFunc gc_finalizer_table_get(const SnGCFinalizerTable* table, const void* object) {
+	if (!table->size) return NULL;
+	return gc_finalizer_table_find(table, object)->free_func;
+}
+
+static inline void gc_finalizer_table_remove_entry(SnGCFinalizerTable* table, SnGCFinalizerEntry* entry) {
+	uintx hole = entry - table->entries;
+	entry->object = NULL;
+	entry->free_func = NULL;
+	--table->size;
+	for (uintx i = (hole + 1) & (table->capacity - 1); table->entries[i].object; i = (i + 1) & (table->capacity - 1)) {
+		// move the entry into the hole, unless its home lies cyclically in (hole, i]
+		uintx home = gc_finalizer_table_home(table, table->entries[i].object);
+		if (((i - home) & (table->capacity - 1)) >= ((i - hole) & (table->capacity - 1))) {
+			table->entries[hole] = table->entries[i];
+			table->entries[i].object = NULL;
+			table->entries[i].free_func = NULL;
+			hole = i;
+		}
+	}
+}
+
+static inline SnGCFreeFunc gc_finalizer_table_remove(SnGCFinalizerTable* table, const void* object) {
+	// Returns the free function that `object' had, if any.
+	if (!table->size) return NULL;
+	SnGCFinalizerEntry* entry = gc_finalizer_table_find(table, object);
+	SnGCFreeFunc free_func = entry->free_func;
+	if (entry->object) gc_finalizer_table_remove_entry(table, entry);
+	return free_func;
+}
+
+static inline void gc_finalizer_table_set(SnGCFinalizerTable* table, const void* object, SnGCFreeFunc free_func) {
+	if (!free_func) {
+		gc_finalizer_table_remove(table, object);
+		return;
+	}
+	if ((table->size + 1) * 4 > table->capacity * 3) {
+		SnGCFinalizerTable grown;
+		grown.size = table->size;
+		grown.capacity = table->capacity ? table->capacity * 2 : GC_FINALIZER_TABLE_INITIAL_CAPACITY;
+		grown.entries = (SnGCFinalizerEntry*)snow_malloc(grown.capacity * sizeof(SnGCFinalizerEntry));
+		memset(grown.entries, 0, grown.capacity * sizeof(SnGCFinalizerEntry));
+		for (uintx i = 0; i < table->capacity; ++i) {
+			if (table->entries[i].object) *gc_finalizer_table_find(&grown, table->entries[i].object) = table->entries[i];
+		}
+		snow_free(table->entries);
+		*table = grown;
+	}
+	
+	SnGCFinalizerEntry* entry = gc_finalizer_table_find(table, object);
+	if (!entry->object) {
+		entry->object = object;
+		++table->size;
+	}
+	entry->free_func = free_func;
+}
+
+#endif /* end of include guard: GCFINALIZERS_H_J5DW0T8E */
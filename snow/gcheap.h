@@ -1,9 +1,112 @@
 #ifndef GC_HEAP_H_94WS3GBG
 #define GC_HEAP_H_94WS3GBG
 
+struct SnGCHeap;
+
+/*
+	The heap index maps every page of every GC chunk to the SnGCHeap that owns it. It is a
+	three-level radix tree over 48-bit addresses, with one entry per page at the bottom level.
+	Chunks are always page-aligned, so a page is never shared between two heaps.
+	
+	Interior levels are only ever added (with compare-and-swap), never removed, so lookups are
+	lock-free and safe during collection.
+*/
+
+#define GC_PAGE_BITS 12
+#define GC_PAGE_SIZE ((size_t)1 << GC_PAGE_BITS)
+#define GC_INDEX_LEVEL_BITS 12
+#define GC_INDEX_LEVEL_SIZE ((uintx)1 << GC_INDEX_LEVEL_BITS)
+#define GC_INDEX_LEVEL_MASK (GC_INDEX_LEVEL_SIZE - 1)
+
+typedef struct SnGCHeapIndexLeaf {
+	struct SnGCHeap* heaps[GC_INDEX_LEVEL_SIZE];
+} SnGCHeapIndexLeaf;
+
+typedef struct SnGCHeapIndexNode {
+	SnGCHeapIndexLeaf* volatile leaves[GC_INDEX_LEVEL_SIZE];
+} SnGCHeapIndexNode;
+
+typedef struct SnGCHeapIndex {
+	SnGCHeapIndexNode* volatile nodes[GC_INDEX_LEVEL_SIZE];
+} SnGCHeapIndex;
+
+static inline struct SnGCHeap* gc_heap_index_lookup(const SnGCHeapIndex* index, const void* ptr) {
+	uintx page = (uintx)ptr >> GC_PAGE_BITS;
+	if (page >> (3*GC_INDEX_LEVEL_BITS)) return NULL; // beyond 48 bits
+	
+	SnGCHeapIndexNode* node = index->nodes[page >> (2*GC_INDEX_LEVEL_BITS)];
+	if (!node) return NULL;
+	SnGCHeapIndexLeaf* leaf = node->leaves[(page >> GC_INDEX_LEVEL_BITS) & GC_INDEX_LEVEL_MASK];
+	if (!leaf) return NULL;
+	return leaf->heaps[page & GC_INDEX_LEVEL_MASK];
+}
+
+static inline SnGCHeapIndexLeaf* gc_heap_index_get_leaf(SnGCHeapIndex* index, uintx page) {
+	ASSERT((page >> (3*GC_INDEX_LEVEL_BITS)) == 0); // chunk beyond 48 bits
+	
+	SnGCHeapIndexNode* volatile* node_p = &index->nodes[page >> (2*GC_INDEX_LEVEL_BITS)];
+	if (!*node_p) {
+		SnGCHeapIndexNode* node = (SnGCHeapIndexNode*)snow_malloc(sizeof(SnGCHeapIndexNode));
+		memset(node, 0, sizeof(SnGCHeapIndexNode));
+		if (!__sync_bool_compare_and_swap(node_p, NULL, node))
+			snow_free(node); // another thread got there first
+	}
+	
+	SnGCHeapIndexLeaf* volatile* leaf_p = &(*node_p)->leaves[(page >> GC_INDEX_LEVEL_BITS) & GC_INDEX_LEVEL_MASK];
+	if (!*leaf_p) {
+		SnGCHeapIndexLeaf* leaf = (SnGCHeapIndexLeaf*)snow_malloc(sizeof(SnGCHeapIndexLeaf));
+		memset(leaf, 0, sizeof(SnGCHeapIndexLeaf));
+		if (!__sync_bool_compare_and_swap(leaf_p, NULL, leaf))
+			snow_free(leaf);
+	}
+	return *leaf_p;
+}
+
+static inline void gc_heap_index_set(SnGCHeapIndex* index, const byte* start, const byte* end, struct SnGCHeap* heap) {
+	ASSERT((uintx)start % GC_PAGE_SIZE == 0); // chunks must be page-aligned
+	uintx first_page = (uintx)start >> GC_PAGE_BITS;
+	uintx last_page = ((uintx)end - 1) >> GC_PAGE_BITS;
+	for (uintx page = first_page; page <= last_page; ++page) {
+		SnGCHeapIndexLeaf* leaf = gc_heap_index_get_leaf(index, page);
+		leaf->heaps[page & GC_INDEX_LEVEL_MASK] = heap;
+	}
+}
+
+
+// ----------------------------------------------------------------------------
+
+
+typedef uintx SnGCBitmapWord;
+#define GC_BITMAP_WORD_BITS (sizeof(SnGCBitmapWord)*8)
+
+typedef byte SnGCCard;
+#define GC_CARD_BITS 9
+#define GC_CARD_SIZE ((size_t)1 << GC_CARD_BITS)
+
 typedef struct SnGCHeap {
 	/*
 		An incremental heap, with separate flags for better CoW-performance during GC.
+		
+		Both side tables are allocated along with the chunk, and never grow:
+		`flags` has room for the largest number of objects that can fit in the heap, and
+		`object_starts` has one bit per SNOW_GC_ALIGNMENT-sized granule, set for every granule
+		that begins an allocation (at the SnGCObjectHead). This allows interior pointers to be
+		resolved to their allocation with a masked bit-scan. Granules are counted from the first
+		allocation, GC_ALLOCATION_OFFSET bytes into the chunk.
+		
+		`cards` has one byte per GC_CARD_SIZE bytes of the chunk, set by the write barrier when a
+		reference to a young object is stored into that part of an old heap.
+		
+		A heap with a nonzero `slot_size` belongs to the size class space (see below), and holds
+		allocations of that total size only.
+		
+		A `large` heap holds exactly one allocation, in a chunk of its own whose memory goes back to
+		the OS as soon as it is freed. It has no object_starts bitmap, since the allocation always
+		begins at `start`.
+		
+		A heap that `needs_sweep` still has the flags from the last major collection, and must be
+		swept with gc_lazy_sweep_heap before it can be allocated from, marked, or have its flags
+		cleared.
 	*/
 	byte* start;
 	byte* current;
@@ -12,31 +115,105 @@ typedef struct SnGCHeap {
 	uint32_t num_objects;
 	uint32_t num_reachable;
 	uint32_t num_indefinite;
+	uint32_t max_objects;
 	
 	SnGCFlags* flags;
-	uint32_t num_flags;
+	SnGCBitmapWord* object_starts;
+	SnGCCard* cards;
+	
+	uint32_t slot_size;
+	byte* free_list;
+	
+	bool large;
+	bool needs_sweep;
+	bool young; // this is a nursery
+	volatile bool has_dirty_cards;
 } SnGCHeap;
 
 static void gc_heap_clear_flags(SnGCHeap*);
 
+static inline size_t gc_heap_bitmap_size(size_t heap_size) {
+	size_t num_granules = heap_size / SNOW_GC_ALIGNMENT;
+	return ((num_granules + GC_BITMAP_WORD_BITS - 1) / GC_BITMAP_WORD_BITS) * sizeof(SnGCBitmapWord);
+}
+
+static inline size_t gc_heap_num_cards(size_t heap_size) {
+	return (heap_size + GC_CARD_SIZE - 1) >> GC_CARD_BITS;
+}
+
 static inline void gc_heap_init(SnGCHeap* heap) {
 	heap->start = heap->current = heap->end = NULL;
 	heap->num_objects = 0;
+	heap->num_reachable = 0;
+	heap->num_indefinite = 0;
+	heap->max_objects = 0;
 	heap->flags = NULL;
-	heap->num_flags = 0;
+	heap->object_starts = NULL;
+	heap->cards = NULL;
+	heap->slot_size = 0;
+	heap->free_list = NULL;
+	heap->large = false;
+	heap->needs_sweep = false;
+	heap->young = false;
+	heap->has_dirty_cards = false;
 }
 
 static inline void gc_heap_finalize(SnGCHeap* heap) {
-	gc_free_chunk(heap->start, heap->end - heap->start);
+	gc_unregister_heap(heap);
+	if (heap->large) {
+		gc_unmap_chunk(heap->start, heap->end - heap->start);
+	} else if (heap->start && gc_recycle_chunk(heap)) {
+		// the pooled chunk keeps the side tables
+		heap->flags = NULL;
+		heap->object_starts = NULL;
+		heap->cards = NULL;
+	} else {
+		gc_free_chunk(heap->start, heap->end - heap->start);
+	}
 	heap->start = heap->current = heap->end = NULL;
 	snow_free(heap->flags);
 	heap->flags = NULL;
-	heap->num_flags = 0;
+	snow_free(heap->object_starts);
+	heap->object_starts = NULL;
+	snow_free(heap->cards);
+	heap->cards = NULL;
+	heap->has_dirty_cards = false;
+	heap->free_list = NULL;
+	heap->max_objects = 0;
+}
+
+static inline byte* gc_heap_first_allocation(const SnGCHeap* heap) {
+	return heap->start + GC_ALLOCATION_OFFSET;
 }
 
 static inline bool gc_heap_contains(const SnGCHeap* heap, const void* root) {
 	const byte* data = (const byte*)root;
-	return heap->start && (data >= heap->start + sizeof(SnGCObjectHead)) && (data < heap->end - sizeof(SnGCObjectTail));
+	return heap->start && (data >= gc_heap_first_allocation(heap) + sizeof(SnGCObjectHead)) && (data < heap->current - GC_TAIL_SIZE);
+}
+
+static inline void gc_heap_init_chunk(SnGCHeap* heap, size_t heap_size) {
+	if (!heap->large && gc_reuse_chunk(heap, heap_size)) return;
+	
+	heap->start = heap->large ? gc_map_chunk(heap_size) : gc_alloc_chunk(heap_size);
+	heap->current = gc_heap_first_allocation(heap);
+	heap->end = heap->start + heap_size;
+	
+	heap->max_objects = heap->large ? 1 : heap_size / GC_MIN_ALLOCATION_SIZE;
+	heap->flags = (SnGCFlags*)snow_malloc(sizeof(SnGCFlags) * heap->max_objects);
+	memset(heap->flags, 0, sizeof(SnGCFlags) * heap->max_objects);
+	
+	if (!heap->large) {
+		size_t bitmap_size = gc_heap_bitmap_size(heap_size);
+		heap->object_starts = (SnGCBitmapWord*)snow_malloc(bitmap_size);
+		memset(heap->object_starts, 0, bitmap_size);
+	}
+	
+	size_t num_cards = gc_heap_num_cards(heap_size);
+	heap->cards = (SnGCCard*)snow_malloc(num_cards);
+	memset(heap->cards, 0, num_cards);
+	heap->has_dirty_cards = false;
+	
+	gc_register_heap(heap);
 }
 
 static inline byte* gc_heap_alloc(SnGCHeap* heap, size_t total_size, uint32_t* out_object_index, size_t heap_size)
@@ -46,9 +223,7 @@ static inline byte* gc_heap_alloc(SnGCHeap* heap, size_t total_size, uint32_t* o
 	// XXX: Lock
 	
 	if (!heap->start) {
-		heap->start = gc_alloc_chunk(heap_size);
-		heap->current = heap->start;
-		heap->end = heap->start + heap_size;
+		gc_heap_init_chunk(heap, heap_size);
 	}
 	
 	// see if we can hold the allocation
@@ -59,43 +234,128 @@ static inline byte* gc_heap_alloc(SnGCHeap* heap, size_t total_size, uint32_t* o
 	byte* ptr = heap->current;
 	heap->current += total_size;
 	*out_object_index = heap->num_objects++;
+	ASSERT(*out_object_index < heap->max_objects);
 	
 	// XXX: Unlock
 	
 	return ptr;
 }
 
-static inline SnGCFlags gc_heap_get_flags(const SnGCHeap* heap, uint32_t flag_index) {
-	ASSERT(flag_index < heap->num_objects);
-	
-	if (heap->flags) {
-		return heap->flags[flag_index];
+static inline void gc_heap_set_object_start(SnGCHeap* heap, const byte* allocation) {
+	if (heap->large) return;
+	uintx granule = (allocation - gc_heap_first_allocation(heap)) / SNOW_GC_ALIGNMENT;
+	heap->object_starts[granule / GC_BITMAP_WORD_BITS] |= (SnGCBitmapWord)1 << (granule % GC_BITMAP_WORD_BITS);
+}
+
+static inline void gc_heap_clear_object_starts(SnGCHeap* heap, const byte* begin, const byte* end) {
+	// forgets the allocations that begin in [begin, end)
+	uintx granule = (begin - gc_heap_first_allocation(heap)) / SNOW_GC_ALIGNMENT;
+	uintx last = (end - gc_heap_first_allocation(heap)) / SNOW_GC_ALIGNMENT;
+	while (granule < last) {
+		uintx bit = granule % GC_BITMAP_WORD_BITS;
+		if (bit == 0 && granule + GC_BITMAP_WORD_BITS <= last) {
+			heap->object_starts[granule / GC_BITMAP_WORD_BITS] = 0;
+			granule += GC_BITMAP_WORD_BITS;
+		} else {
+			heap->object_starts[granule / GC_BITMAP_WORD_BITS] &= ~((SnGCBitmapWord)1 << bit);
+			++granule;
+		}
 	}
+}
+
+static inline byte* gc_heap_find_allocation(const SnGCHeap* heap, const void* ptr) {
+	/*
+		Returns the start of the allocation (the SnGCObjectHead) that contains ptr, i.e. the
+		closest object start at or below ptr.
+	*/
+	if (heap->large) return gc_heap_first_allocation(heap);
+	uintx granule = ((const byte*)ptr - gc_heap_first_allocation(heap)) / SNOW_GC_ALIGNMENT;
+	uintx word = granule / GC_BITMAP_WORD_BITS;
+	uintx bit = granule % GC_BITMAP_WORD_BITS;
 	
-	return 0;
+	// mask out starts above ptr -- when bit is the top bit, the shift wraps to 0, and the mask becomes all ones.
+	SnGCBitmapWord bits = heap->object_starts[word] & (((SnGCBitmapWord)2 << bit) - 1);
+	while (!bits) {
+		ASSERT(word > 0); // no allocation below ptr
+		bits = heap->object_starts[--word];
+	}
+	return gc_heap_first_allocation(heap) + (word * GC_BITMAP_WORD_BITS + snow_highest_bit_index(bits)) * SNOW_GC_ALIGNMENT;
+}
+
+static inline SnGCFlags gc_heap_get_flags(const SnGCHeap* heap, uint32_t flag_index) {
+	ASSERT(flag_index < heap->num_objects);
+	return heap->flags[flag_index];
 }
 
 static inline void gc_heap_set_flags(SnGCHeap* heap, uint32_t flag_index, byte flags) {
 	ASSERT(flag_index < heap->num_objects);
-	
-	if (heap->num_objects > heap->num_flags) {
-		uint32_t num = heap->num_flags;
-		heap->num_flags = 2*heap->num_objects;
-		heap->flags = snow_realloc(heap->flags, sizeof(SnGCFlags)*heap->num_flags);
-		memset(heap->flags + num, 0, sizeof(SnGCFlags)*(heap->num_flags - num));
-	}
-	
 	heap->flags[flag_index] |= flags;
 }
 
+static inline void gc_heap_unset_flags(SnGCHeap* heap, uint32_t flag_index, byte flags) {
+	ASSERT(flag_index < heap->num_objects);
+	heap->flags[flag_index] &= ~flags;
+}
+
+static inline SnGCFlags gc_heap_fetch_and_set_flags(SnGCHeap* heap, uint32_t flag_index, byte flags) {
+	// atomic version of gc_heap_set_flags, returning the previous flags
+	ASSERT(flag_index < heap->num_objects);
+	return __sync_fetch_and_or(&heap->flags[flag_index], flags);
+}
+
 static inline void gc_heap_clear_flags(SnGCHeap* heap) {
-	snow_free(heap->flags);
-	heap->flags = NULL;
-	heap->num_flags = 0;
+	if (heap->flags) {
+		memset(heap->flags, 0, sizeof(SnGCFlags)*heap->num_objects);
+	}
 	heap->num_indefinite = 0;
 	heap->num_reachable = 0;
 }
 
+static inline void gc_heap_dirty_card(SnGCHeap* heap, const void* ptr) {
+	heap->cards[((const byte*)ptr - heap->start) >> GC_CARD_BITS] = 1;
+	heap->has_dirty_cards = true;
+}
+
+static inline void gc_heap_dirty_range(SnGCHeap* heap, const byte* begin, const byte* end) {
+	if (begin >= end) return;
+	uintx first = (begin - heap->start) >> GC_CARD_BITS;
+	uintx last = (end - 1 - heap->start) >> GC_CARD_BITS;
+	memset(heap->cards + first, 1, last - first + 1);
+	heap->has_dirty_cards = true;
+}
+
+static inline void gc_heap_clear_cards(SnGCHeap* heap) {
+	if (heap->has_dirty_cards) {
+		memset(heap->cards, 0, gc_heap_num_cards(heap->end - heap->start));
+		heap->has_dirty_cards = false;
+	}
+}
+
+static inline void gc_heap_with_dirty_objects_do(SnGCHeap* heap, void(*action)(SnGCHeap*, byte* allocation, void* userdata), void* userdata) {
+	/*
+		Calls action for each allocation (at its SnGCObjectHead) that overlaps a dirty card.
+		Each allocation is visited once, even if it spans several dirty cards.
+	*/
+	if (!heap->has_dirty_cards) return;
+	size_t num_cards = gc_heap_num_cards(heap->end - heap->start);
+	byte* next = gc_heap_first_allocation(heap); // allocations below this have been visited
+	for (size_t i = 0; i < num_cards; ++i) {
+		if (!heap->cards[i]) continue;
+		byte* card_start = heap->start + (i << GC_CARD_BITS);
+		byte* card_end = card_start + GC_CARD_SIZE;
+		if (card_start >= heap->current) break;
+		
+		byte* p = card_start < next ? next : gc_heap_find_allocation(heap, card_start);
+		while (p < card_end && p < heap->current) {
+			const SnGCObjectHead* head = (const SnGCObjectHead*)p;
+			byte* p_next = p + GC_ALLOCATION_OVERHEAD + head->alloc_info.size;
+			action(heap, p, userdata);
+			p = p_next;
+		}
+		next = p;
+	}
+}
+
 static inline size_t gc_heap_available(const SnGCHeap* heap) {
 	return heap->end - heap->current;
 }
@@ -129,6 +389,7 @@ static inline SnGCHeapListNode* gc_heap_list_push_heap(SnGCHeapList* list, SnGCH
 	
 	if (heap) {
 		memcpy(&node->heap, heap, sizeof(SnGCHeap));
+		gc_register_heap(&node->heap); // the heap has moved
 	} else {
 		gc_heap_init(&node->heap);
 	}
@@ -156,7 +417,7 @@ static inline void gc_heap_list_clear(SnGCHeapList* list) {
 	gc_heap_list_init(list);
 }
 
-static byte* gc_heap_list_alloc(SnGCHeapList* list, size_t size, uint32_t* out_object_index, size_t heap_size)
+static byte* gc_heap_list_alloc(SnGCHeapList* list, size_t size, uint32_t* out_object_index, size_t heap_size, SnGCHeap** out_heap)
 {
 	SnGCHeapListNode* node = list->head;
 	while (node != NULL) {
@@ -170,24 +431,115 @@ static byte* gc_heap_list_alloc(SnGCHeapList* list, size_t size, uint32_t* out_o
 	
 	byte* data = gc_heap_alloc(&node->heap, size, out_object_index, heap_size);
 	ASSERT(data != NULL); // heap list allocations may not return NULL! Something is wrong.
+	*out_heap = &node->heap;
 	return data;
 }
 
-static SnGCHeap* gc_heap_list_find_heap(const SnGCHeapList* list, const void* ptr) {
+static inline void gc_heap_list_clear_flags(SnGCHeapList* list) {
 	SnGCHeapListNode* node = list->head;
 	while (node != NULL) {
-		if (gc_heap_contains(&node->heap, ptr)) return &node->heap;
+		// heaps waiting to be swept clear their own flags when they are
+		if (!node->heap.needs_sweep) gc_heap_clear_flags(&node->heap);
 		node = node->next;
 	}
-	return NULL;
 }
 
-static inline void gc_heap_list_clear_flags(SnGCHeapList* list) {
-	SnGCHeapListNode* node = list->head;
+
+// ----------------------------------------------------------------------------
+
+
+/*
+	The size class space is a non-moving old generation. Every heap in it holds slots of a single
+	size class, allocated from a free list, or by bumping when the free list is empty. Heaps are
+	swept in place: a dead object keeps its SnGCObjectHead (with alloc_type GC_INVALID, so stale
+	pointers into the slot are recognized), and the slot is linked into the free list through its
+	first data word. Since all slots in a heap have the same size, the object index of a slot is
+	its position in the heap.
+	
+	Sizes up to 128 bytes are spaced 16 bytes apart; above that, there are four classes per
+	power of two. A slot holds its class size plus the allocation overhead, rounded up to the
+	alignment, so the data of a slot can be up to SNOW_GC_ALIGNMENT-1 bytes larger than its class.
+*/
+
+#define GC_NUM_SIZE_CLASSES 28
+static const uint16_t GC_SIZE_CLASSES[GC_NUM_SIZE_CLASSES] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256,
+	320, 384, 448, 512,
+	640, 768, 896, 1024,
+	1280, 1536, 1792, 2048,
+	2560, 3072, 3584, 4096
+};
+
+static inline uint32_t gc_size_class_index(size_t size) {
+	ASSERT(size > 0 && size <= GC_SIZE_CLASSES[GC_NUM_SIZE_CLASSES-1]);
+	if (size <= 128) return (size - 1) / 16;
+	uint32_t log = snow_highest_bit_index(size - 1);
+	size_t base = (size_t)1 << log;
+	return 8 + (log - 7) * 4 + (size - 1 - base) / (base / 4);
+}
+
+typedef struct SnGCSizeClassSpace {
+	SnGCHeapList heaps[GC_NUM_SIZE_CLASSES];
+	SnGCHeapListNode* cursors[GC_NUM_SIZE_CLASSES]; // where to look for a free slot first, NULL for the head
+} SnGCSizeClassSpace;
+
+static inline void gc_size_class_space_init(SnGCSizeClassSpace* space) {
+	for (uint32_t i = 0; i < GC_NUM_SIZE_CLASSES; ++i) {
+		gc_heap_list_init(&space->heaps[i]);
+		space->cursors[i] = NULL;
+	}
+}
+
+static inline bool gc_heap_has_free_slot(const SnGCHeap* heap) {
+	return !heap->start || heap->free_list || heap->current + heap->slot_size <= heap->end;
+}
+
+static inline byte* gc_heap_alloc_slot(SnGCHeap* heap, uint32_t* out_object_index, size_t heap_size) {
+	byte* slot = heap->free_list;
+	if (slot) {
+		heap->free_list = *(byte**)(slot + sizeof(SnGCObjectHead));
+		*out_object_index = (slot - gc_heap_first_allocation(heap)) / heap->slot_size;
+		return slot;
+	}
+	return gc_heap_alloc(heap, heap->slot_size, out_object_index, heap_size);
+}
+
+static inline void gc_heap_free_slot(SnGCHeap* heap, byte* slot) {
+	*(byte**)(slot + sizeof(SnGCObjectHead)) = heap->free_list;
+	heap->free_list = slot;
+}
+
+static byte* gc_size_class_space_alloc(SnGCSizeClassSpace* space, size_t size, uint32_t* out_object_index, size_t heap_size, SnGCHeap** out_heap)
+{
+	/*
+		Allocates a slot for an object of `size` bytes, which must then be initialized with the
+		size of the slot's data rather than `size`.
+	*/
+	uint32_t c = gc_size_class_index(size >= SNOW_GC_ALIGNMENT ? size - SNOW_GC_ALIGNMENT + 1 : 1);
+	SnGCHeapListNode* node = space->cursors[c] ? space->cursors[c] : space->heaps[c].head;
 	while (node != NULL) {
-		gc_heap_clear_flags(&node->heap);
+		if (node->heap.needs_sweep) gc_lazy_sweep_heap(&node->heap, false);
+		if (gc_heap_has_free_slot(&node->heap)) break;
 		node = node->next;
 	}
+	
+	if (node == NULL) {
+		node = gc_heap_list_push_heap(&space->heaps[c], NULL);
+		node->heap.slot_size = snow_gc_round(GC_ALLOCATION_OVERHEAD + GC_SIZE_CLASSES[c]);
+	}
+	space->cursors[c] = node;
+	
+	byte* data = gc_heap_alloc_slot(&node->heap, out_object_index, heap_size);
+	ASSERT(data != NULL); // size class allocations may not return NULL! Something is wrong.
+	*out_heap = &node->heap;
+	return data;
+}
+
+static inline void gc_size_class_space_reset_cursors(SnGCSizeClassSpace* space) {
+	for (uint32_t i = 0; i < GC_NUM_SIZE_CLASSES; ++i) {
+		space->cursors[i] = NULL;
+	}
 }
 
 #endif /* end of include guard: GC_HEAP_H_94WS3GBG */
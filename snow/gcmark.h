@@ -0,0 +1,178 @@
+#ifndef GCMARK_H_7QK2XN4C
+#define GCMARK_H_7QK2XN4C
+
+/*
+	The mark stack is used by the serial mark phase and by the pointer update phase, in place of
+	recursion. It grows on demand up to a fixed limit. When it is full, pushes fail and the caller
+	flags the object with GC_OVERFLOWED instead, to be picked up by a rescan of the heaps, so that
+	memory use stays bounded no matter the shape of the heap.
+*/
+
+typedef struct SnGCMarkStack {
+	VALUE* items;
+	uintx size;
+	uintx capacity;
+	uintx limit;
+	bool overflowed;
+} SnGCMarkStack;
+
+#define GC_MARK_STACK_INITIAL_CAPACITY 4096
+
+static inline void gc_mark_stack_init(SnGCMarkStack* stack, uintx limit) {
+	stack->items = NULL;
+	stack->size = stack->capacity = 0;
+	stack->limit = limit;
+	stack->overflowed = false;
+}
+
+static inline bool gc_mark_stack_push(SnGCMarkStack* stack, VALUE value) {
+	if (stack->size == stack->capacity) {
+		if (stack->capacity >= stack->limit) {
+			stack->overflowed = true;
+			return false;
+		}
+		uintx new_capacity = stack->capacity ? stack->capacity * 2 : GC_MARK_STACK_INITIAL_CAPACITY;
+		if (new_capacity > stack->limit) new_capacity = stack->limit;
+		VALUE* items = (VALUE*)snow_malloc(sizeof(VALUE) * new_capacity);
+		memcpy(items, stack->items, sizeof(VALUE) * stack->size);
+		snow_free(stack->items);
+		stack->items = items;
+		stack->capacity = new_capacity;
+	}
+	stack->items[stack->size++] = value;
+	return true;
+}
+
+static inline bool gc_mark_stack_pop(SnGCMarkStack* stack, VALUE* out_value) {
+	if (stack->size == 0) return false;
+	*out_value = stack->items[--stack->size];
+	return true;
+}
+
+
+// ----------------------------------------------------------------------------
+
+/*
+	Mark deques for parallel marking. Each GC worker owns one deque of objects that have been
+	marked, but whose children have not yet been scanned. The owner pushes and pops at the tail,
+	and idle workers steal from the head. Deques are protected by a spinlock; they are only ever
+	contended when somebody is stealing.
+*/
+
+typedef struct SnGCMarkItem {
+	byte* object;
+	SnGCAllocInfo* alloc_info;
+} SnGCMarkItem;
+
+typedef struct SnGCMarkDeque {
+	volatile int lock;
+	SnGCMarkItem* items;
+	volatile uintx head; // steal end
+	volatile uintx tail; // push/pop end
+	uintx capacity;
+} SnGCMarkDeque;
+
+#define GC_MARK_DEQUE_INITIAL_CAPACITY 1024
+
+static inline void gc_spin_pause() {
+	__asm__ __volatile__("pause\n");
+}
+
+static inline void gc_spin_lock(volatile int* lock) {
+	while (__sync_lock_test_and_set(lock, 1)) {
+		while (*lock) gc_spin_pause();
+	}
+}
+
+static inline void gc_spin_unlock(volatile int* lock) {
+	__sync_lock_release(lock);
+}
+
+static inline void gc_mark_deque_init(SnGCMarkDeque* deque) {
+	deque->lock = 0;
+	deque->capacity = GC_MARK_DEQUE_INITIAL_CAPACITY;
+	deque->items = (SnGCMarkItem*)snow_malloc(sizeof(SnGCMarkItem) * deque->capacity);
+	deque->head = deque->tail = 0;
+}
+
+static inline uintx gc_mark_deque_size(const SnGCMarkDeque* deque) {
+	// racy, only for peeking
+	return deque->tail - deque->head;
+}
+
+static inline void _gc_mark_deque_push_unlocked(SnGCMarkDeque* deque, const SnGCMarkItem* item) {
+	if (deque->tail == deque->capacity) {
+		uintx size = deque->tail - deque->head;
+		if (deque->head > deque->capacity / 2) {
+			// plenty of room at the head end
+			memmove(deque->items, deque->items + deque->head, sizeof(SnGCMarkItem) * size);
+		} else {
+			deque->capacity *= 2;
+			SnGCMarkItem* items = (SnGCMarkItem*)snow_malloc(sizeof(SnGCMarkItem) * deque->capacity);
+			memcpy(items, deque->items + deque->head, sizeof(SnGCMarkItem) * size);
+			snow_free(deque->items);
+			deque->items = items;
+		}
+		deque->head = 0;
+		deque->tail = size;
+	}
+	deque->items[deque->tail++] = *item;
+}
+
+static inline void gc_mark_deque_push(SnGCMarkDeque* deque, const SnGCMarkItem* item) {
+	gc_spin_lock(&deque->lock);
+	_gc_mark_deque_push_unlocked(deque, item);
+	gc_spin_unlock(&deque->lock);
+}
+
+static inline bool gc_mark_deque_pop(SnGCMarkDeque* deque, SnGCMarkItem* out_item) {
+	bool found = false;
+	gc_spin_lock(&deque->lock);
+	if (deque->tail > deque->head) {
+		*out_item = deque->items[--deque->tail];
+		found = true;
+	}
+	if (deque->tail == deque->head) deque->head = deque->tail = 0;
+	gc_spin_unlock(&deque->lock);
+	return found;
+}
+
+#define GC_MARK_STEAL_BATCH 64
+
+static inline bool gc_mark_deque_steal(SnGCMarkDeque* victim, SnGCMarkDeque* thief, SnGCMarkItem* out_item) {
+	/*
+		Takes up to half of victim's items (but at most GC_MARK_STEAL_BATCH), returning one of
+		them in out_item and pushing the rest to thief. Only one lock is held at a time.
+	*/
+	if (gc_mark_deque_size(victim) == 0) return false;
+	
+	SnGCMarkItem batch[GC_MARK_STEAL_BATCH];
+	uintx n = 0;
+	gc_spin_lock(&victim->lock);
+	uintx size = victim->tail - victim->head;
+	n = (size + 1) / 2;
+	if (n > GC_MARK_STEAL_BATCH) n = GC_MARK_STEAL_BATCH;
+	memcpy(batch, victim->items + victim->head, sizeof(SnGCMarkItem) * n);
+	victim->head += n;
+	if (victim->tail == victim->head) victim->head = victim->tail = 0;
+	gc_spin_unlock(&victim->lock);
+	
+	if (n == 0) return false;
+	*out_item = batch[0];
+	if (n > 1) {
+		gc_spin_lock(&thief->lock);
+		for (uintx i = 1; i < n; ++i) {
+			_gc_mark_deque_push_unlocked(thief, &batch[i]);
+		}
+		gc_spin_unlock(&thief->lock);
+	}
+	return true;
+}
+
+static inline void gc_mark_deque_finalize(SnGCMarkDeque* deque) {
+	snow_free(deque->items);
+	deque->items = NULL;
+	deque->head = deque->tail = deque->capacity = 0;
+}
+
+#endif /* end of include guard: GCMARK_H_7QK2XN4C */
@@ -0,0 +1,165 @@
+#ifndef GCRESERVE_H_6QXN2PLM
+#define GCRESERVE_H_6QXN2PLM
+
+/*
+	The reservation is one large range of address space, mapped at startup without committing any
+	memory, from which all GC chunks are carved. Pages are only backed once they are touched, and
+	given back with madvise when a chunk is freed. Keeping every chunk in one range lets pointers
+	that are not in any heap be rejected with a single range compare, before the heap index is
+	consulted.
+	
+	Chunks are managed by a buddy allocator: every block is a power of two in size, from a page up
+	to the whole reservation, and aligned to its own size. Each order has a bitmap of its free
+	blocks, itself in memory that is mapped lazily, so the bitmaps of a large reservation cost
+	nothing until they are used. Chunks that don't fit (or if the reservation could not be mapped)
+	fall back to ordinary allocation, outside the range.
+*/
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+#ifdef ARCH_IS_64_BIT
+#define GC_RESERVATION_DEFAULT_SIZE ((uintx)1 << 36) // 64 GiB
+#else
+#define GC_RESERVATION_DEFAULT_SIZE ((uintx)1 << 29) // 512 MiB
+#endif
+#define GC_RESERVATION_MIN_SIZE ((uintx)1 << 26) // smaller reservations are not worth it
+#define GC_RESERVATION_MAX_ORDERS (sizeof(uintx)*8)
+
+typedef struct SnGCReservation {
+	byte* start; // NULL if there is no reservation
+	byte* end;
+	uint8_t min_order; // log2 of the smallest block, a page
+	uint8_t max_order; // log2 of the whole reservation
+	SnGCBitmapWord* free_blocks[GC_RESERVATION_MAX_ORDERS]; // by order; bit i is block i of that size
+	uintx num_free[GC_RESERVATION_MAX_ORDERS];
+	uintx first_free[GC_RESERVATION_MAX_ORDERS]; // there are no free blocks below this index
+	byte* bitmaps; // of all orders
+	size_t bitmaps_size;
+	pthread_mutex_t lock;
+	volatile uintx num_outside; // chunks that were allocated outside the reservation, and are still in use
+} SnGCReservation;
+
+static inline bool gc_reservation_contains(const SnGCReservation* reservation, const void* ptr) {
+	return (const byte*)ptr >= reservation->start && (const byte*)ptr < reservation->end;
+}
+
+static inline uint8_t gc_reservation_order(const SnGCReservation* reservation, size_t size) {
+	// the order of the smallest block that holds `size' bytes
+	uint8_t order = size > 1 ? snow_highest_bit_index(size - 1) + 1 : 0;
+	return order < reservation->min_order ? reservation->min_order : order;
+}
+
+static inline bool gc_reservation_is_free(const SnGCReservation* reservation, uint8_t order, uintx block) {
+	return (reservation->free_blocks[order][block / GC_BITMAP_WORD_BITS] >> (block % GC_BITMAP_WORD_BITS)) & 1;
+}
+
+static inline void gc_reservation_set_free(SnGCReservation* reservation, uint8_t order, uintx block) {
+	reservation->free_blocks[order][block / GC_BITMAP_WORD_BITS] |= (SnGCBitmapWord)1 << (block % GC_BITMAP_WORD_BITS);
+	++reservation->num_free[order];
+	if (block < reservation->first_free[order]) reservation->first_free[order] = block;
+}
+
+static inline void gc_reservation_clear_free(SnGCReservation* reservation, uint8_t order, uintx block) {
+	reservation->free_blocks[order][block / GC_BITMAP_WORD_BITS] &= ~((SnGCBitmapWord)1 << (block % GC_BITMAP_WORD_BITS));
+	--reservation->num_free[order];
+}
+
+static inline uintx gc_reservation_take_free(SnGCReservation* reservation, uint8_t order) {
+	// Takes the lowest free block of `order', which must have one.
+	ASSERT(reservation->num_free[order]);
+	SnGCBitmapWord* bitmap = reservation->free_blocks[order];
+	uintx word = reservation->first_free[order] / GC_BITMAP_WORD_BITS;
+	while (!bitmap[word]) ++word;
+	uintx block = word * GC_BITMAP_WORD_BITS + __builtin_ctzll(bitmap[word]);
+	gc_reservation_clear_free(reservation, order, block);
+	reservation->first_free[order] = block + 1;
+	return block;
+}
+
+static inline void gc_reservation_init(SnGCReservation* reservation, uintx size, bool huge_pages) {
+	// `size' must be a power of two; smaller ones are tried until one can be mapped
+	memset(reservation, 0, sizeof(SnGCReservation));
+	pthread_mutex_init(&reservation->lock, NULL);
+	byte* mapping = MAP_FAILED;
+	for (; size >= GC_RESERVATION_MIN_SIZE; size /= 2) {
+		// twice the size, so that the reservation can be aligned to its own size
+		mapping = (byte*)mmap(NULL, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+		if (mapping != MAP_FAILED) break;
+	}
+	if (mapping == MAP_FAILED) return;
+	
+	byte* start = (byte*)(((uintx)mapping + size - 1) & ~(size - 1));
+	if (start > mapping) munmap(mapping, start - mapping);
+	if (start + size < mapping + 2 * size) munmap(start + size, mapping + 2 * size - (start + size));
+	#ifdef MADV_HUGEPAGE
+	if (huge_pages) madvise(start, size, MADV_HUGEPAGE);
+	#endif
+	
+	reservation->min_order = GC_PAGE_BITS;
+	reservation->max_order = snow_highest_bit_index(size);
+	size_t bitmaps_size = 0;
+	for (uint8_t order = reservation->min_order; order <= reservation->max_order; ++order) {
+		uintx num_blocks = size >> order;
+		bitmaps_size += (num_blocks + GC_BITMAP_WORD_BITS - 1) / GC_BITMAP_WORD_BITS * sizeof(SnGCBitmapWord);
+	}
+	byte* bitmaps = (byte*)mmap(NULL, bitmaps_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+	if (bitmaps == MAP_FAILED) {
+		munmap(start, size);
+		return;
+	}
+	reservation->bitmaps = bitmaps;
+	reservation->bitmaps_size = bitmaps_size;
+	for (uint8_t order = reservation->min_order; order <= reservation->max_order; ++order) {
+		reservation->free_blocks[order] = (SnGCBitmapWord*)bitmaps;
+		uintx num_blocks = size >> order;
+		bitmaps += (num_blocks + GC_BITMAP_WORD_BITS - 1) / GC_BITMAP_WORD_BITS * sizeof(SnGCBitmapWord);
+	}
+	gc_reservation_set_free(reservation, reservation->max_order, 0);
+	reservation->start = start;
+	reservation->end = start + size;
+}
+
+static inline void* gc_reservation_alloc(SnGCReservation* reservation, size_t size) {
+	// Returns a block of at least `size' bytes, aligned to its size, or NULL if none is left.
+	if (!reservation->start) return NULL;
+	uint8_t order = gc_reservation_order(reservation, size);
+	if (order > reservation->max_order) return NULL;
+	
+	pthread_mutex_lock(&reservation->lock);
+	uint8_t from = order;
+	while (from <= reservation->max_order && !reservation->num_free[from]) ++from;
+	if (from > reservation->max_order) {
+		pthread_mutex_unlock(&reservation->lock);
+		return NULL;
+	}
+	uintx block = gc_reservation_take_free(reservation, from);
+	while (from > order) {
+		// split, keeping the lower half
+		--from;
+		block *= 2;
+		gc_reservation_set_free(reservation, from, block + 1);
+	}
+	pthread_mutex_unlock(&reservation->lock);
+	return reservation->start + (block << order);
+}
+
+static inline void gc_reservation_free(SnGCReservation* reservation, void* ptr, size_t size) {
+	// The pages of the block must already have been given back to the OS.
+	ASSERT(gc_reservation_contains(reservation, ptr));
+	uint8_t order = gc_reservation_order(reservation, size);
+	uintx block = ((byte*)ptr - reservation->start) >> order;
+	
+	pthread_mutex_lock(&reservation->lock);
+	while (order < reservation->max_order && gc_reservation_is_free(reservation, order, block ^ 1)) {
+		// merge with the buddy
+		gc_reservation_clear_free(reservation, order, block ^ 1);
+		block /= 2;
+		++order;
+	}
+	gc_reservation_set_free(reservation, order, block);
+	pthread_mutex_unlock(&reservation->lock);
+}
+
+#endif /* end of include guard: GCRESERVE_H_6QXN2PLM */
@@ -0,0 +1,105 @@
+#ifndef GCSAMPLE_H_R4HV8ZQ1
+#define GCSAMPLE_H_R4HV8ZQ1
+
+/*
+	The allocation sampler. Each thread keeps the Snow functions it is calling, and every time it
+	has allocated about another sampling interval's worth of bytes, the allocation that crosses the
+	line is sampled along with those functions. The sample waits for the next collection of its
+	object, which tells whether it survived, and is then added to the profile as a folded stack:
+
+		outermost function;...;innermost function;type (survived) estimated bytes
+*/
+
+#define GC_SAMPLER_MAX_DEPTH 64 // deeper calls are not recorded
+#define GC_SAMPLER_DEFAULT_INTERVAL 0x80000 // bytes; 512 KiB
+
+typedef struct SnGCSamplerCall {
+	VALUE function; // a root
+	const void* frame; // of snow_function_call, which lets calls left by longjmp be dropped
+} SnGCSamplerCall;
+
+typedef struct SnGCSamplerStack {
+	SnGCSamplerCall calls[GC_SAMPLER_MAX_DEPTH];
+	uintx size;
+} SnGCSamplerStack;
+
+static inline void gc_sampler_stack_unwind(SnGCSamplerStack* stack, const void* frame) {
+	// Drops the calls made from below `frame', which have returned or been unwound. Stacks grow down.
+	while (stack->size && stack->calls[stack->size-1].frame <= frame) --stack->size;
+}
+
+typedef struct SnGCSample {
+	byte* object; // not a root; the object is only looked at by the collection that decides its fate
+	char* stack; // of function names, each followed by a semicolon
+	uint64_t bytes; // estimated, i.e. the bytes allocated per sample of this size
+} SnGCSample;
+
+typedef struct SnGCSampleRecord {
+	char* stack; // complete with the type and fate, or NULL for an empty slot
+	uint64_t hash;
+	uint64_t bytes;
+	uint64_t num_samples;
+} SnGCSampleRecord;
+
+typedef struct SnGCSampleTable {
+	// open addressing, with linear probing
+	SnGCSampleRecord* records;
+	uintx size;
+	uintx capacity; // a power of two
+} SnGCSampleTable;
+
+#define GC_SAMPLE_TABLE_INITIAL_CAPACITY 256
+
+static inline uint64_t gc_sample_hash(const char* str) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (; *str; ++str) {
+		hash ^= (byte)*str;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static inline SnGCSampleRecord* gc_sample_table_find(SnGCSampleRecord* records, uintx capacity, const char* stack, uint64_t hash) {
+	// Returns the record of `stack', or the empty slot where it belongs.
+	for (uintx i = hash & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+		SnGCSampleRecord* record = &records[i];
+		if (!record->stack || (record->hash == hash && strcmp(record->stack, stack) == 0)) return record;
+	}
+}
+
+static inline void gc_sample_table_add(SnGCSampleTable* table, const char* stack, uint64_t bytes) {
+	if ((table->size + 1) * 4 > table->capacity * 3) {
+		uintx new_capacity = table->capacity ? table->capacity * 2 : GC_SAMPLE_TABLE_INITIAL_CAPACITY;
+		SnGCSampleRecord* records = (SnGCSampleRecord*)snow_malloc(new_capacity * sizeof(SnGCSampleRecord));
+		memset(records, 0, new_capacity * sizeof(SnGCSampleRecord));
+		for (uintx i = 0; i < table->capacity; ++i) {
+			SnGCSampleRecord* record = &table->records[i];
+			if (record->stack) *gc_sample_table_find(records, new_capacity, record->stack, record->hash) = *record;
+		}
+		snow_free(table->records);
+		table->records = records;
+		table->capacity = new_capacity;
+	}
+	
+	uint64_t hash = gc_sample_hash(stack);
+	SnGCSampleRecord* record = gc_sample_table_find(table->records, table->capacity, stack, hash);
+	if (!record->stack) {
+		size_t length = strlen(stack);
+		record->stack = (char*)snow_malloc(length + 1);
+		memcpy(record->stack, stack, length + 1);
+		record->hash = hash;
+		++table->size;
+	}
+	record->bytes += bytes;
+	++record->num_samples;
+}
+
+static inline void gc_sample_table_clear(SnGCSampleTable* table) {
+	for (uintx i = 0; i < table->capacity; ++i) snow_free(table->records[i].stack);
+	snow_free(table->records);
+	table->records = NULL;
+	table->size = table->capacity = 0;
+}
+
+#endif /* end of include guard: GCSAMPLE_H_R4HV8ZQ1 */
@@ -0,0 +1,101 @@
+#ifndef GCSITES_H_K2P7RWQD
+#define GCSITES_H_K2P7RWQD
+
+/*
+	Allocation sites, for pretenuring. A site is the return address of a call to
+	snow_alloc_any_object, i.e. the constructor of the object, or the generated code that calls it.
+	Each nursery remembers the site of every object allocated in it, by object index, and minor
+	collections count how many of them survived. Once a site has enough of them, its survival rate
+	decides: sites whose objects nearly all survive are pretenured, and have their objects
+	allocated straight into the old generation, where they would have been transplanted anyway.
+	One in GC_PRETENURE_SAMPLE_RATE of those still goes to the nursery, so that the survival rate of
+	the site keeps being measured, and the site is demoted again if it drops.
+	
+	The table maps addresses to site ids, with open addressing and linear probing. It has a fixed
+	capacity, so lookups need no lock: entries are only ever added, under the lock, with the id
+	written before the address.
+*/
+
+#define GC_MAX_ALLOCATION_SITES 0x1000 // later sites are never pretenured
+#define GC_SITE_TABLE_CAPACITY (2 * GC_MAX_ALLOCATION_SITES)
+#define GC_PRETENURE_MIN_SAMPLES 256 // objects counted before a site is decided on
+#define GC_PRETENURE_PERCENT 90 // sites with more survivors than this are pretenured
+#define GC_DEMOTE_PERCENT 50 // and demoted again with fewer than this
+#define GC_PRETENURE_SAMPLE_RATE 16
+
+typedef uint16_t SnGCSiteId; // 0 for no site
+
+typedef struct SnGCSite {
+	const void* address;
+	uint32_t allocated; // in nurseries, counted by the minor collections since the last decision
+	uint32_t survived;
+	volatile uint32_t num_tenured; // allocations in the old generation, which picks the samples; racy
+	bool pretenured;
+} SnGCSite;
+
+typedef struct SnGCSiteSlot {
+	const void* volatile address; // NULL for an empty slot
+	SnGCSiteId id;
+} SnGCSiteSlot;
+
+typedef struct SnGCSiteTable {
+	SnGCSiteSlot* slots; // GC_SITE_TABLE_CAPACITY of them
+	SnGCSite* sites; // by id; the first one is unused
+	volatile uint32_t num_sites; // including the unused one
+	pthread_mutex_t lock; // held while adding
+} SnGCSiteTable;
+
+static inline void gc_site_table_init(SnGCSiteTable* table) {
+	table->slots = (SnGCSiteSlot*)snow_malloc(GC_SITE_TABLE_CAPACITY * sizeof(SnGCSiteSlot));
+	memset(table->slots, 0, GC_SITE_TABLE_CAPACITY * sizeof(SnGCSiteSlot));
+	table->sites = (SnGCSite*)snow_malloc(GC_MAX_ALLOCATION_SITES * sizeof(SnGCSite));
+	memset(table->sites, 0, GC_MAX_ALLOCATION_SITES * sizeof(SnGCSite));
+	table->num_sites = 1;
+	pthread_mutex_init(&table->lock, NULL);
+}
+
+static inline uintx gc_site_table_home(const void* address) {
+	uint64_t hash = (uint64_t)(uintx)address * 0x9e3779b97f4a7c15ULL;
+	return (uintx)(hash >> 32) & (GC_SITE_TABLE_CAPACITY - 1);
+}
+
+static inline SnGCSiteSlot* gc_site_table_find(const SnGCSiteTable* table, const void* address) {
+	// Returns the slot of `address', or the empty slot where it belongs.
+	for (uintx i = gc_site_table_home(address);; i = (i + 1) & (GC_SITE_TABLE_CAPACITY - 1)) {
+		SnGCSiteSlot* slot = &table->slots[i];
+		const void* a = slot->address;
+		if (!a || a == address) return slot;
+	}
+}
+
+static inline SnGCSiteId gc_site_table_get(SnGCSiteTable* table, const void* address) {
+	// Returns the id of the site at `address', adding it if it's new, or 0 if the table is full.
+	SnGCSiteSlot* slot = gc_site_table_find(table, address);
+	if (slot->address) return slot->id;
+	if (table->num_sites >= GC_MAX_ALLOCATION_SITES) return 0;
+	
+	pthread_mutex_lock(&table->lock);
+	slot = gc_site_table_find(table, address); // someone else may have added it, or taken the slot
+	if (!slot->address && table->num_sites < GC_MAX_ALLOCATION_SITES) {
+		SnGCSiteId id = table->num_sites;
+		table->sites[id].address = address;
+		slot->id = id;
+		__sync_synchronize();
+		slot->address = address;
+		table->num_sites = id + 1;
+	}
+	SnGCSiteId id = slot->address ? slot->id : 0;
+	pthread_mutex_unlock(&table->lock);
+	return id;
+}
+
+static inline void gc_site_decide(SnGCSite* site) {
+	// Called by minor collections as they count; starts a new count once there is a decision.
+	if (site->allocated < GC_PRETENURE_MIN_SAMPLES) return;
+	uint64_t percent = (uint64_t)site->survived * 100 / site->allocated;
+	if (percent > GC_PRETENURE_PERCENT) site->pretenured = true;
+	else if (percent < GC_DEMOTE_PERCENT) site->pretenured = false;
+	site->allocated = site->survived = 0;
+}
+
+#endif /* end of include guard: GCSITES_H_K2P7RWQD */
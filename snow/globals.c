@@ -2,6 +2,7 @@
 #include "snow/intern.h"
 #include "snow/snow.h"
 #include "snow/exception.h"
+#include "snow/array.h"
 #include <stdio.h>
 
 static inline void set_global(SnContext* ctx, SnSymbol name, VALUE val) {
@@ -41,6 +42,92 @@ SNOW_FUNC(_throw) {
 	return SN_NIL;
 }
 
+SNOW_FUNC(_gc_collect) {
+	snow_gc();
+	return SN_NIL;
+}
+
+SNOW_FUNC(_gc_dump) {
+	REQUIRE_ARGS(1);
+	ASSERT_TYPE(ARGS[0], SN_STRING_TYPE);
+	const char* path = snow_string_cstr((SnString*)ARGS[0]);
+	if (!snow_gc_dump_heap(path)) snow_throw_exception_with_description("Could not write heap dump to %s.", path);
+	return SN_NIL;
+}
+
+SNOW_FUNC(_gc_write_alloc_profile) {
+	REQUIRE_ARGS(1);
+	ASSERT_TYPE(ARGS[0], SN_STRING_TYPE);
+	const char* path = snow_string_cstr((SnString*)ARGS[0]);
+	if (!snow_gc_write_alloc_profile(path)) snow_throw_exception_with_description("Could not write allocation profile to %s.", path);
+	return SN_NIL;
+}
+
+static inline void set_stat(SnObject* stats, const char* name, VALUE value) {
+	snow_object_set_member(stats, stats, snow_symbol(name), value);
+}
+
+static SnObject* create_phase_times(const SnGCPhaseTimes* times) {
+	SnObject* obj = snow_create_object(NULL);
+	set_stat(obj, "mark", int_to_value(times->mark));
+	set_stat(obj, "sweep", int_to_value(times->sweep));
+	set_stat(obj, "update", int_to_value(times->update));
+	set_stat(obj, "finalize", int_to_value(times->finalize));
+	return obj;
+}
+
+SNOW_FUNC(_gc_stats) {
+	// a snapshot; times are in microseconds, sizes in bytes
+	SnGCStatistics stats;
+	snow_gc_get_stats(&stats);
+	SnObject* obj = snow_create_object(NULL);
+	set_stat(obj, "collections", int_to_value(stats.num_collections));
+	set_stat(obj, "major_collections", int_to_value(stats.num_major_collections));
+	set_stat(obj, "total_pause_time", int_to_value(stats.total_pause_time));
+	set_stat(obj, "last_pause_time", int_to_value(stats.last_pause_time));
+	set_stat(obj, "max_pause_time", int_to_value(stats.max_pause_time));
+	set_stat(obj, "total_time_to_safepoint", int_to_value(stats.total_time_to_safepoint));
+	set_stat(obj, "last_time_to_safepoint", int_to_value(stats.last_time_to_safepoint));
+	set_stat(obj, "max_time_to_safepoint", int_to_value(stats.max_time_to_safepoint));
+	set_stat(obj, "slices", int_to_value(stats.num_slices));
+	set_stat(obj, "total_slice_time", int_to_value(stats.total_slice_time));
+	set_stat(obj, "last_slice_time", int_to_value(stats.last_slice_time));
+	set_stat(obj, "max_slice_time", int_to_value(stats.max_slice_time));
+	set_stat(obj, "total_phase_time", create_phase_times(&stats.total_phase_time));
+	set_stat(obj, "last_phase_time", create_phase_times(&stats.last_phase_time));
+	SnArray* histogram = snow_create_array_with_size(SNOW_GC_PAUSE_HISTOGRAM_SIZE);
+	for (intx i = 0; i < SNOW_GC_PAUSE_HISTOGRAM_SIZE; ++i) {
+		snow_array_push(histogram, int_to_value(stats.pause_histogram[i]));
+	}
+	set_stat(obj, "pause_histogram", histogram);
+	set_stat(obj, "bytes_allocated", int_to_value(stats.bytes_allocated));
+	set_stat(obj, "bytes_promoted", int_to_value(stats.bytes_promoted));
+	set_stat(obj, "bytes_pretenured", int_to_value(stats.bytes_pretenured));
+	set_stat(obj, "bytes_survived", int_to_value(stats.bytes_survived));
+	set_stat(obj, "last_bytes_allocated", int_to_value(stats.last_bytes_allocated));
+	set_stat(obj, "last_bytes_survived", int_to_value(stats.last_bytes_survived));
+	set_stat(obj, "survival_rate", float_to_value(stats.survival_rate));
+	set_stat(obj, "last_survival_rate", float_to_value(stats.last_survival_rate));
+	set_stat(obj, "nursery_size", int_to_value(stats.nursery_size));
+	set_stat(obj, "adult_size", int_to_value(stats.adult_size));
+	set_stat(obj, "size_class_size", int_to_value(stats.size_class_size));
+	set_stat(obj, "big_size", int_to_value(stats.big_size));
+	set_stat(obj, "unkillable_size", int_to_value(stats.unkillable_size));
+	set_stat(obj, "pinned_size", int_to_value(stats.pinned_size));
+	set_stat(obj, "total_mem_usage", int_to_value(stats.total_mem_usage));
+	set_stat(obj, "num_pretenured_sites", int_to_value(stats.num_pretenured_sites));
+	return obj;
+}
+
+static SnObject* create_gc_object() {
+	SnObject* gc = snow_create_object(NULL);
+	snow_object_set_member(gc, gc, snow_symbol("collect"), snow_create_function_with_name(_gc_collect, "collect"));
+	snow_object_set_member(gc, gc, snow_symbol("dump"), snow_create_function_with_name(_gc_dump, "dump"));
+	snow_object_set_member(gc, gc, snow_symbol("write_alloc_profile"), snow_create_function_with_name(_gc_write_alloc_profile, "write_alloc_profile"));
+	snow_define_object_property(gc, "stats", _gc_stats, NULL);
+	return gc;
+}
+
 void snow_init_globals(SnContext* ctx)
 {
 	// base classes
@@ -72,4 +159,5 @@ void snow_init_globals(SnContext* ctx)
 	set_global(ctx, snow_symbol("puts"), snow_create_function_with_name(_puts, "puts"));
 	set_global(ctx, snow_symbol("print"), snow_create_function_with_name(_print, "print"));
 	set_global(ctx, snow_symbol("throw"), snow_create_function_with_name(_throw, "throw"));
+	set_global(ctx, snow_symbol("GC"), create_gc_object());
 }
\ No newline at end of file
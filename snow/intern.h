@@ -91,9 +91,17 @@ static inline SnObjectType snow_typeof(VALUE val)
 	return 0;
 }
 
-#ifdef DTRACE
+#ifdef HAVE_CONFIG_H
+#include "config.h" // for DTRACE and HAVE_SYS_SDT_H
+#endif
+
+#if defined(DTRACE)
 #define DTRACE_PROBE(X) SNOWPROBE_ ## X
 #include "snow_provider.h"
+#elif defined(HAVE_SYS_SDT_H)
+#include "snow_provider_sdt.h"
+#undef DTRACE_PROBE // sys/sdt.h has its own
+#define DTRACE_PROBE(X) SNOWPROBE_ ## X
 #else
 #define DTRACE_PROBE(X) 
 #endif
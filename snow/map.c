@@ -15,6 +15,7 @@ SnMap* snow_create_map()
 	SnMap* map = (SnMap*)snow_alloc_any_object(SN_MAP_TYPE, sizeof(SnMap));
 	map->size = 0;
 	map->data = NULL;
+	map->capacity = 0;
 	map->compare = snow_map_compare_default;
 	return map;
 }
@@ -56,18 +57,31 @@ void snow_map_set(SnMap* map, VALUE key, VALUE value)
 		if (map->compare(tuples[i].key, key) == 0)
 		{
 			tuples[i].value = value;
+			snow_gc_write_barrier(&tuples[i].value, value);
 			return;
 		}
 	}
 	
-	// TODO: preallocate
-	void* new_data = snow_gc_alloc_blob(sizeof(SnMapTuple) * (map->size + 1));
-	memcpy(new_data, map->data, map->size * sizeof(SnMapTuple));
+	if (map->size == map->capacity)
+	{
+		// geometric growth, so that adding keys doesn't copy the map every time
+		uintx capacity = map->capacity ? map->capacity * 2 : 4;
+		void* new_data;
+		if (map->data)
+			new_data = snow_gc_realloc_hint(map->data, sizeof(SnMapTuple) * (map->size + 1), sizeof(SnMapTuple) * capacity);
+		else
+			new_data = snow_gc_alloc_blob(sizeof(SnMapTuple) * capacity);
+		map->data = new_data;
+		snow_gc_write_barrier(&map->data, new_data);
+		map->capacity = snow_gc_allocated_size(new_data) / sizeof(SnMapTuple);
+	}
+	
 	i = map->size++;
-	map->data = new_data;
 	tuples = map->data;
 	tuples[i].key = key;
+	snow_gc_write_barrier(&tuples[i].key, key);
 	tuples[i].value = value;
+	snow_gc_write_barrier(&tuples[i].value, value);
 }
 
 int snow_map_compare_default(VALUE a, VALUE b)
@@ -13,6 +13,7 @@ typedef struct SnMap {
 	uintx size;
 	struct SnMapTuple* data;
 	SnMapCompare compare;
+	uintx capacity; // tuples that fit in data
 } SnMap;
 
 CAPI SnMap* snow_create_map();
@@ -12,8 +12,9 @@
 SnObjectBase* snow_alloc_any_object(SnObjectType type, uintx size)
 {
 	ASSERT(size > sizeof(SnObjectBase) && "You probably don't want to allocate an SnObjectBase.");
-	SnObjectBase* base = (SnObjectBase*)snow_gc_alloc_object(size);
+	SnObjectBase* base = (SnObjectBase*)snow_gc_alloc_object_at(size, __builtin_return_address(0));
 	base->type = type;
+	DTRACE_PROBE(OBJECT_ALLOC(type, size));
 	return base;
 }
 
@@ -103,7 +104,10 @@ static inline VALUE object_set_with_property(SnObject* obj, VALUE self, SnSymbol
 VALUE snow_object_set_member(SnObject* obj, VALUE self, SnSymbol member, VALUE val)
 {
 	if (!obj->members)
+	{
 		obj->members = snow_create_map();
+		snow_gc_write_barrier(&obj->members, obj->members);
+	}
 	
 	VALUE with_property = object_set_with_property(obj, self, member, val);
 	if (with_property) return with_property;
@@ -235,7 +239,10 @@ SNOW_FUNC(object_members) {
 		SnObject* self = (SnObject*)SELF;
 		
 		if (!self->members)
+		{
 			self->members = snow_create_map();
+			snow_gc_write_barrier(&self->members, self->members);
+		}
 		
 		return self->members;
 	}
@@ -31,6 +31,8 @@ typedef enum SnObjectType
 	SN_POINTER_TYPE,
 	SN_AST_TYPE,
 	SN_DEFERRED_TASK_TYPE,
+	SN_WEAK_REF_TYPE,
+	SN_WEAK_MAP_TYPE,
 	
 	SN_THIN_OBJECT_TYPE_MAX,
 	
@@ -0,0 +1,86 @@
+#ifndef SAFEPOINT_H_R4TZ8MWC
+#define SAFEPOINT_H_R4TZ8MWC
+
+/*
+	Parking threads at safepoints, for the task implementations that run tasks on several threads.
+	A thread parks by setting its own `parked' word; the thread that stops the world sets the shared
+	`stop' word, and then waits until every other thread has parked. Both sides sleep on futexes:
+	the stopping thread on the `parked' word of the thread it waits for, the parked threads on
+	`stop', so a parked thread costs nothing until it is released, and releasing all of them is a
+	single wake-up call.
+	
+	Each side writes its own word before it reads the other's, with a full barrier in between, so
+	they can't both miss each other: a thread that leaves just as the world is being stopped either
+	sees `stop' and parks again, or is seen running by the stopping thread, which waits for it.
+	Wake-ups are only sent to a side that may be asleep.
+	
+	Where there are no futexes, waiting yields the processor instead, which is correct, but spins.
+	On Linux, syscall() is only declared with _GNU_SOURCE, which has to be defined before the first
+	system header of the including file.
+*/
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sched.h>
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#error "snow/safepoint.h needs _GNU_SOURCE on Linux, for syscall()"
+#endif
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+typedef volatile int32_t SnFutexWord;
+
+static inline void safepoint_futex_wait(SnFutexWord* word, int32_t value) {
+	// Returns when `*word' may no longer be `value', or spuriously.
+	#ifdef __linux__
+	syscall(SYS_futex, (int32_t*)word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+	#else
+	if (*word == value) sched_yield();
+	#endif
+}
+
+static inline void safepoint_futex_wake(SnFutexWord* word) {
+	// wakes everyone waiting on `word'
+	#ifdef __linux__
+	syscall(SYS_futex, (int32_t*)word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+	#endif
+}
+
+static inline void safepoint_park(SnFutexWord* parked, SnFutexWord* stop) {
+	*parked = 1;
+	__sync_synchronize();
+	if (*stop) safepoint_futex_wake(parked); // the stopping thread may be waiting for this one
+}
+
+static inline void safepoint_unpark(SnFutexWord* parked, SnFutexWord* stop) {
+	// Returns once the world isn't stopped, with the thread no longer parked.
+	for (;;) {
+		while (*stop) safepoint_futex_wait(stop, 1);
+		*parked = 0;
+		__sync_synchronize();
+		if (!*stop) return;
+		// the world is being stopped again, and the stopping thread may already count on this one
+		safepoint_park(parked, stop);
+	}
+}
+
+static inline void safepoint_stop(SnFutexWord* stop) {
+	*stop = 1;
+	__sync_synchronize();
+}
+
+static inline void safepoint_wait_parked(SnFutexWord* parked) {
+	while (!*parked) safepoint_futex_wait(parked, 0);
+}
+
+static inline void safepoint_release(SnFutexWord* stop) {
+	*stop = 0;
+	__sync_synchronize();
+	safepoint_futex_wake(stop);
+}
+
+#endif /* end of include guard: SAFEPOINT_H_R4TZ8MWC */
@@ -85,6 +85,8 @@ void snow_init()
 	basic_classes[SN_SYMBOL_TYPE] = snow_create_class("Symbol");
 	basic_classes[SN_FLOAT_TYPE] = snow_create_class("Float");
 	basic_classes[SN_DEFERRED_TASK_TYPE] = snow_create_class("DeferredTask");
+	basic_classes[SN_WEAK_REF_TYPE] = snow_create_class("WeakRef");
+	basic_classes[SN_WEAK_MAP_TYPE] = snow_create_class("WeakMap");
 	
 	// initialize all base classes
 	init_object_class(basic_classes[SN_OBJECT_TYPE]);
@@ -107,6 +109,8 @@ void snow_init()
 	init_symbol_class(basic_classes[SN_SYMBOL_TYPE]);
 	init_float_class(basic_classes[SN_FLOAT_TYPE]);
 	init_deferred_task_class(basic_classes[SN_DEFERRED_TASK_TYPE]);
+	init_weak_ref_class(basic_classes[SN_WEAK_REF_TYPE]);
+	init_weak_map_class(basic_classes[SN_WEAK_MAP_TYPE]);
 }
 
 VALUE snow_eval(const char* str)
@@ -410,6 +414,7 @@ VALUE snow_get_member_with_fallback(VALUE self, SnSymbol sym)
 	SnObject* closest_object = get_closest_object(self);
 	VALUE member = snow_object_get_member(closest_object, self, sym);
 	if (!member) {
+		DTRACE_PROBE(LOOKUP_MISS(snow_symbol_to_cstr(sym), snow_typeof(self)));
 		VALUE member_missing = snow_object_get_member(closest_object, self, snow_symbol("member_missing"));
 		if (member_missing) {
 			member = snow_call(self, member_missing, 1, symbol_to_value(sym));
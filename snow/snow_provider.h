@@ -15,6 +15,30 @@ extern "C" {
 
 #define SNOWPROBE_TYPEDEFS "___dtrace_typedefs$SnowProbe$v2"
 
+#define	SNOWPROBE_COMPILE_END(arg0, arg1, arg2) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$compile_end$v1$63686172202a$63686172202a$75696e7436345f74(arg0, arg1, arg2); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_COMPILE_END_ENABLED() \
+	__dtrace_isenabled$SnowProbe$compile_end$v1()
+#define	SNOWPROBE_COMPILE_START(arg0, arg1) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$compile_start$v1$63686172202a$63686172202a(arg0, arg1); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_COMPILE_START_ENABLED() \
+	__dtrace_isenabled$SnowProbe$compile_start$v1()
+#define	SNOWPROBE_EXCEPTION_THROW(arg0) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$exception_throw$v1$75696e7436345f74(arg0); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_EXCEPTION_THROW_ENABLED() \
+	__dtrace_isenabled$SnowProbe$exception_throw$v1()
 #define	SNOWPROBE_GC() \
 do { \
 	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
@@ -55,8 +79,54 @@ do { \
 } while (0)
 #define	SNOWPROBE_GC_MINOR_ENABLED() \
 	__dtrace_isenabled$SnowProbe$gc_minor$v1()
+#define	SNOWPROBE_GC_PROMOTE(arg0, arg1, arg2) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$gc_promote$v1$75696e7436345f74$75696e7436345f74$75696e7436345f74(arg0, arg1, arg2); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_GC_PROMOTE_ENABLED() \
+	__dtrace_isenabled$SnowProbe$gc_promote$v1()
+#define	SNOWPROBE_LOOKUP_MISS(arg0, arg1) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$lookup_miss$v1$63686172202a$75696e7433325f74(arg0, arg1); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_LOOKUP_MISS_ENABLED() \
+	__dtrace_isenabled$SnowProbe$lookup_miss$v1()
+#define	SNOWPROBE_OBJECT_ALLOC(arg0, arg1) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$object_alloc$v1$75696e7433325f74$75696e7436345f74(arg0, arg1); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_OBJECT_ALLOC_ENABLED() \
+	__dtrace_isenabled$SnowProbe$object_alloc$v1()
+#define	SNOWPROBE_TASK_JOIN(arg0) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$task_join$v1$75696e7436345f74(arg0); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_TASK_JOIN_ENABLED() \
+	__dtrace_isenabled$SnowProbe$task_join$v1()
+#define	SNOWPROBE_TASK_SPAWN(arg0) \
+do { \
+	__asm__ volatile(".reference " SNOWPROBE_TYPEDEFS); \
+	__dtrace_probe$SnowProbe$task_spawn$v1$75696e7436345f74(arg0); \
+	__asm__ volatile(".reference " SNOWPROBE_STABILITY); \
+} while (0)
+#define	SNOWPROBE_TASK_SPAWN_ENABLED() \
+	__dtrace_isenabled$SnowProbe$task_spawn$v1()
 
 
+extern void __dtrace_probe$SnowProbe$compile_end$v1$63686172202a$63686172202a$75696e7436345f74(char *, char *, uint64_t);
+extern int __dtrace_isenabled$SnowProbe$compile_end$v1(void);
+extern void __dtrace_probe$SnowProbe$compile_start$v1$63686172202a$63686172202a(char *, char *);
+extern int __dtrace_isenabled$SnowProbe$compile_start$v1(void);
+extern void __dtrace_probe$SnowProbe$exception_throw$v1$75696e7436345f74(uint64_t);
+extern int __dtrace_isenabled$SnowProbe$exception_throw$v1(void);
 extern void __dtrace_probe$SnowProbe$gc$v1(void);
 extern int __dtrace_isenabled$SnowProbe$gc$v1(void);
 extern void __dtrace_probe$SnowProbe$gc_alloc$v1$75696e7436345f74(uint64_t);
@@ -67,6 +137,16 @@ extern void __dtrace_probe$SnowProbe$gc_major$v1(void);
 extern int __dtrace_isenabled$SnowProbe$gc_major$v1(void);
 extern void __dtrace_probe$SnowProbe$gc_minor$v1(void);
 extern int __dtrace_isenabled$SnowProbe$gc_minor$v1(void);
+extern void __dtrace_probe$SnowProbe$gc_promote$v1$75696e7436345f74$75696e7436345f74$75696e7436345f74(uint64_t, uint64_t, uint64_t);
+extern int __dtrace_isenabled$SnowProbe$gc_promote$v1(void);
+extern void __dtrace_probe$SnowProbe$lookup_miss$v1$63686172202a$75696e7433325f74(char *, uint32_t);
+extern int __dtrace_isenabled$SnowProbe$lookup_miss$v1(void);
+extern void __dtrace_probe$SnowProbe$object_alloc$v1$75696e7433325f74$75696e7436345f74(uint32_t, uint64_t);
+extern int __dtrace_isenabled$SnowProbe$object_alloc$v1(void);
+extern void __dtrace_probe$SnowProbe$task_join$v1$75696e7436345f74(uint64_t);
+extern int __dtrace_isenabled$SnowProbe$task_join$v1(void);
+extern void __dtrace_probe$SnowProbe$task_spawn$v1$75696e7436345f74(uint64_t);
+extern int __dtrace_isenabled$SnowProbe$task_spawn$v1(void);
 
 #ifdef	__cplusplus
 }
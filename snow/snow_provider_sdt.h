@@ -0,0 +1,29 @@
+/*
+	The probes of snow_provider.d as Linux USDT probes, for perf and bpftrace, e.g.:
+
+		bpftrace -e 'usdt:./snow:SnowProbe:gc_promote { @bytes = sum(arg2); }'
+
+	Each probe is a nop and an ELF note, and costs no more than evaluating its arguments when
+	nothing is attached to it. Keep it in sync with snow_provider.d by hand.
+*/
+
+#ifndef SNOW_PROVIDER_SDT_H_6W2LQ0RC
+#define SNOW_PROVIDER_SDT_H_6W2LQ0RC
+
+#include <sys/sdt.h>
+
+#define SNOWPROBE_COMPILE_END(arg0, arg1, arg2) STAP_PROBE3(SnowProbe, compile_end, arg0, arg1, arg2)
+#define SNOWPROBE_COMPILE_START(arg0, arg1) STAP_PROBE2(SnowProbe, compile_start, arg0, arg1)
+#define SNOWPROBE_EXCEPTION_THROW(arg0) STAP_PROBE1(SnowProbe, exception_throw, arg0)
+#define SNOWPROBE_GC() STAP_PROBE(SnowProbe, gc)
+#define SNOWPROBE_GC_ALLOC(arg0) STAP_PROBE1(SnowProbe, gc_alloc, arg0)
+#define SNOWPROBE_GC_FINISHED(arg0, arg1) STAP_PROBE2(SnowProbe, gc_finished, arg0, arg1)
+#define SNOWPROBE_GC_MAJOR() STAP_PROBE(SnowProbe, gc_major)
+#define SNOWPROBE_GC_MINOR() STAP_PROBE(SnowProbe, gc_minor)
+#define SNOWPROBE_GC_PROMOTE(arg0, arg1, arg2) STAP_PROBE3(SnowProbe, gc_promote, arg0, arg1, arg2)
+#define SNOWPROBE_LOOKUP_MISS(arg0, arg1) STAP_PROBE2(SnowProbe, lookup_miss, arg0, arg1)
+#define SNOWPROBE_OBJECT_ALLOC(arg0, arg1) STAP_PROBE2(SnowProbe, object_alloc, arg0, arg1)
+#define SNOWPROBE_TASK_JOIN(arg0) STAP_PROBE1(SnowProbe, task_join, arg0)
+#define SNOWPROBE_TASK_SPAWN(arg0) STAP_PROBE1(SnowProbe, task_spawn, arg0)
+
+#endif /* end of include guard: SNOW_PROVIDER_SDT_H_6W2LQ0RC */
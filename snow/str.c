@@ -24,6 +24,7 @@ SnString* snow_create_string(const char* cstr_utf8)
 	SnString* str = (SnString*)snow_alloc_any_object(SN_STRING_TYPE, sizeof(SnString));
 	uintx len = strlen(cstr_utf8);
 	str->data = snow_gc_alloc_atomic(len+1);
+	snow_gc_write_barrier(&str->data, str->data);
 	memcpy(str->data, cstr_utf8, len+1);
 	str->size = len;
 	str->length = strlen_locale(str->data, len);
@@ -34,6 +35,7 @@ SnString* snow_create_string_from_data(const byte* cstr_utf8, size_t num_bytes)
 {
 	SnString* str = (SnString*)snow_alloc_any_object(SN_STRING_TYPE, sizeof(SnString));
 	str->data = snow_gc_alloc_atomic(num_bytes+1);
+	snow_gc_write_barrier(&str->data, str->data);
 	memcpy(str->data, cstr_utf8, num_bytes);
 	str->data[num_bytes] = '\0';
 	str->size = num_bytes;
@@ -46,6 +48,7 @@ SnString* snow_create_string_from_linkbuffer(SnLinkBuffer* buffer)
 	SnString* str = (SnString*)snow_alloc_any_object(SN_STRING_TYPE, sizeof(SnString));
 	uintx len = snow_linkbuffer_size(buffer);
 	str->data = snow_gc_alloc_atomic(len + 1);
+	snow_gc_write_barrier(&str->data, str->data);
 	snow_linkbuffer_copy_data(buffer, str->data, len);
 	str->data[len] = '\0';
 	str->size = len;
@@ -106,6 +109,7 @@ SnString* snow_string_concatenate(SnString* a, SnString* b)
 	SnString* str = (SnString*)snow_alloc_any_object(SN_STRING_TYPE, sizeof(SnString));
 	uintx len_result = len_a + len_b;
 	str->data = snow_gc_alloc_atomic(len_result + 1);
+	snow_gc_write_barrier(&str->data, str->data);
 	memcpy(str->data, a->data, len_a);
 	memcpy(&str->data[len_a], b->data, len_b);
 	str->data[len_result] = '\0';
@@ -1,8 +1,10 @@
+#define _GNU_SOURCE // for syscall(), in snow/safepoint.h
 #include "snow/task.h"
 #include "snow/task-intern.h"
 #include "snow/continuation.h"
 #include "snow/intern.h"
 #include "snow/exception-intern.h"
+#include "snow/safepoint.h"
 
 #include <dispatch/dispatch.h>
 #include <dispatch/group.h>
@@ -11,7 +13,7 @@
 
 typedef struct SnDispatchThreadState {
 	SnTask* current_task;
-	dispatch_semaphore_t gc_barrier;
+	SnFutexWord parked; // set while the thread is in a GC barrier
 	struct SnDispatchThreadState* previous;
 	struct SnDispatchThreadState* next;
 } SnDispatchThreadState;
@@ -19,12 +21,13 @@ typedef struct SnDispatchThreadState {
 static pthread_key_t state_key;
 static dispatch_semaphore_t state_lock = NULL;
 static SnDispatchThreadState* state = NULL;
+static SnFutexWord world_stopped = 0; // parked threads sleep on this until the collection is over
 
 static SnDispatchThreadState* init_thread() {
 	ASSERT(pthread_getspecific(state_key) == NULL);
 	SnDispatchThreadState* s = (SnDispatchThreadState*)snow_malloc(sizeof(SnDispatchThreadState));
 	s->current_task = NULL;
-	s->gc_barrier = dispatch_semaphore_create(0); // starts locked
+	s->parked = 0;
 	s->previous = NULL;
 	
 	// prepend this state to the list of thread states
@@ -43,13 +46,12 @@ static SnDispatchThreadState* init_thread() {
 
 static void finalize_thread(void* _state) {
 	SnDispatchThreadState* s = (SnDispatchThreadState*)_state;
-	dispatch_semaphore_signal(s->gc_barrier); // when finalizing a thread during gc, we don't want to wait for this.
+	safepoint_park(&s->parked, &world_stopped); // when finalizing a thread during gc, we don't want to wait for this.
 	dispatch_semaphore_wait(state_lock, DISPATCH_TIME_FOREVER);
 	if (s->next) s->next->previous = s->previous;
 	if (s->previous) s->previous->next = s->next;
 	state = s->next;
 	dispatch_semaphore_signal(state_lock);
-	dispatch_release(s->gc_barrier);
 	snow_free(s);
 }
 
@@ -137,6 +139,7 @@ void snow_parallel_for_each(void* data, size_t element_size, size_t num_elements
 	
 	SnTask* current_task = get_state()->current_task;
 	
+	DTRACE_PROBE(TASK_SPAWN(num_elements));
 	if (current_task->previous) {
 		// already in parallel, don't spawn further threads
 		for (size_t i = 0; i < num_elements; ++i) {
@@ -152,6 +155,7 @@ void snow_parallel_for_each(void* data, size_t element_size, size_t num_elements
 			});
 		});
 	}
+	DTRACE_PROBE(TASK_JOIN(num_elements));
 	
 	collect_exceptions_and_rethrow(tasks, num_elements);
 }
@@ -169,41 +173,40 @@ void snow_task_pause() {
 	SnTask* task = snow_get_current_task();
 	ASSERT(task->stack_bottom == NULL); // pausing already hibernated task!
 	GET_STACK_PTR(task->stack_bottom);
+	GET_CALLER_BASE_PTR(task->frame_ptr);
 }
 
 void snow_task_resume() {
 	SnTask* task = snow_get_current_task();
 	ASSERT(task->stack_bottom != NULL); // resuming non-hibernated task!
 	task->stack_bottom = NULL;
+	task->frame_ptr = NULL;
 }
 
 void snow_gc_barrier_enter() {
-	snow_task_pause();
-	dispatch_semaphore_signal(get_state()->gc_barrier);
+	snow_task_pause(); // this frame and its callers stay put while parked, so their stack maps apply
+	safepoint_park(&get_state()->parked, &world_stopped);
 }
 
 void snow_gc_barrier_leave() {
-	dispatch_semaphore_wait(get_state()->gc_barrier, DISPATCH_TIME_FOREVER);
+	safepoint_unpark(&get_state()->parked, &world_stopped);
 	snow_task_resume();
 }
 
 void snow_set_gc_barriers() {
+	// The collector has set the poll word, so busy threads reach a barrier at their next poll.
 	dispatch_semaphore_wait(state_lock, DISPATCH_TIME_FOREVER);
 	SnDispatchThreadState* me = get_state();
+	safepoint_stop(&world_stopped);
 	with_each_thread_do(^(SnDispatchThreadState* s) {
 		if (s != me && s->current_task) {
-			dispatch_semaphore_wait(s->gc_barrier, DISPATCH_TIME_FOREVER); // TODO: Emit a warning if this is taking too long.
+			safepoint_wait_parked(&s->parked);
 		}
 	});
 }
 
 void snow_unset_gc_barriers() {
-	SnDispatchThreadState* me = get_state();
-	with_each_thread_do(^(SnDispatchThreadState* s) {
-		if (s != me && s->current_task) {
-			dispatch_semaphore_signal(s->gc_barrier);
-		}
-	});
+	safepoint_release(&world_stopped);
 	dispatch_semaphore_signal(state_lock);
 }
 
@@ -239,6 +242,7 @@ SnDeferredTask* snow_deferred_call(VALUE closure) {
 		perform_task(task->task, ^{
 			volatile SnDeferredTask* my_task = task; // root for gc
 			my_task->result = snow_call(NULL, closure, 0);
+			snow_gc_write_barrier((const void*)&my_task->result, my_task->result);
 		});
 		task->task = NULL;
 	});
@@ -15,6 +15,7 @@ typedef struct SnTask {
 	struct SnContinuation* base; // catch-all for exceptions
 	void* stack_top;
 	void* stack_bottom;
+	void* frame_ptr; // of the function that paused the task, if it is still running during GC
 } SnTask;
 
 CAPI SnTask* snow_get_current_task();
@@ -1,3 +1,4 @@
+#include "snow/intern.h"
 #include "snow/task.h"
 #include "snow/task-intern.h"
 #include "snow/array.h"
@@ -29,6 +30,20 @@ SnTask* snow_get_current_task() {
 	return current_task;
 }
 
+void snow_task_pause() {
+	SnTask* task = snow_get_current_task();
+	ASSERT(task->stack_bottom == NULL); // pausing already hibernated task!
+	GET_STACK_PTR(task->stack_bottom);
+	GET_CALLER_BASE_PTR(task->frame_ptr);
+}
+
+void snow_task_resume() {
+	SnTask* task = snow_get_current_task();
+	ASSERT(task->stack_bottom != NULL); // resuming non-hibernated task!
+	task->stack_bottom = NULL;
+	task->frame_ptr = NULL;
+}
+
 void snow_with_each_task_do(SnTaskIteratorFunc func, void* userdata) {
 	for (SnTask* t = current_task; t != NULL; t = t->previous) {
 		func(t, userdata);
@@ -70,8 +85,13 @@ void snow_parallel_for_each(void* data, size_t element_size, size_t num_elements
 	SnTask tasks[num_elements];
 	memset(tasks, 0, sizeof(tasks));
 	
+	DTRACE_PROBE(TASK_SPAWN(num_elements));
 	for (size_t i = 0; i < num_elements; ++i) {
 		SnTask* task = tasks + i;
+		SnTask* parent_task = current_task;
+		if (parent_task) {
+			snow_task_pause(); // so a collection during the task scans the parent's stack too
+		}
 		
 		GET_STACK_PTR(task->stack_top);
 		task->previous = current_task;
@@ -91,7 +111,13 @@ void snow_parallel_for_each(void* data, size_t element_size, size_t num_elements
 		}
 
 		current_task = task->previous;
+		ASSERT(current_task == parent_task); // stack corruption?
+		
+		if (parent_task) {
+			snow_task_resume();
+		}
 	}
+	DTRACE_PROBE(TASK_JOIN(num_elements));
 	
 	collect_exceptions_and_rethrow(tasks, num_elements);
 }
@@ -109,6 +135,7 @@ VALUE snow_deferred_task_wait(SnDeferredTask* task) {
 	// TODO: add custom timeout
 	if (task->result == NULL) {
 		task->result = snow_call(NULL, task->closure, 0);
+		snow_gc_write_barrier(&task->result, task->result);
 	}
 	return task->result;
 }
@@ -13,6 +13,7 @@ SnExceptionHandler* snow_current_exception_handler()
 void snow_push_exception_handler(SnExceptionHandler* handler)
 {
 	handler->previous = snow_current_exception_handler();
+	snow_gc_write_barrier(&handler->previous, handler->previous);
 	snow_get_current_task()->exception_handler = handler;
 }
 
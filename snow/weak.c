@@ -0,0 +1,147 @@
+#include "snow/weak.h"
+#include "snow/gc.h"
+#include "snow/snow.h"
+#include "snow/class.h"
+#include "snow/array.h"
+#include "snow/intern.h"
+
+SnWeakRef* snow_create_weak_ref(VALUE target)
+{
+	SnWeakRef* ref = (SnWeakRef*)snow_alloc_any_object(SN_WEAK_REF_TYPE, sizeof(SnWeakRef));
+	ref->target = target;
+	snow_gc_add_weak(ref);
+	return ref;
+}
+
+SnWeakMap* snow_create_weak_map()
+{
+	SnWeakMap* map = (SnWeakMap*)snow_alloc_any_object(SN_WEAK_MAP_TYPE, sizeof(SnWeakMap));
+	map->size = 0;
+	map->data = NULL;
+	map->compare = snow_map_compare_default;
+	map->capacity = 0;
+	snow_gc_add_weak(map);
+	return map;
+}
+
+SnWeakMap* snow_create_weak_map_with_compare(SnMapCompare cmp)
+{
+	SnWeakMap* map = snow_create_weak_map();
+	map->compare = cmp;
+	return map;
+}
+
+bool snow_weak_map_contains(SnWeakMap* map, VALUE key)
+{
+	return snow_weak_map_get(map, key) != NULL;
+}
+
+VALUE snow_weak_map_get(SnWeakMap* map, VALUE key)
+{
+	for (uintx i = 0; i < map->size; ++i) {
+		if (map->compare(map->data[i].key, key) == 0)
+			return map->data[i].value;
+	}
+	return NULL;
+}
+
+void snow_weak_map_set(SnWeakMap* map, VALUE key, VALUE value)
+{
+	ASSERT(key && "Cannot use NULL as key in Snow maps!");
+	// the entries need no write barriers, since the GC looks at every weak map in every collection
+	for (uintx i = 0; i < map->size; ++i) {
+		if (map->compare(map->data[i].key, key) == 0)
+		{
+			map->data[i].value = value;
+			return;
+		}
+	}
+	
+	if (map->size == map->capacity)
+	{
+		uintx capacity = map->capacity ? map->capacity * 2 : 4;
+		void* new_data;
+		if (map->data)
+			new_data = snow_gc_realloc_hint(map->data, sizeof(SnWeakMapEntry) * (map->size + 1), sizeof(SnWeakMapEntry) * capacity);
+		else
+			new_data = snow_gc_alloc_atomic(sizeof(SnWeakMapEntry) * capacity);
+		map->data = new_data;
+		snow_gc_write_barrier(&map->data, new_data);
+		map->capacity = snow_gc_allocated_size(new_data) / sizeof(SnWeakMapEntry);
+	}
+	
+	uintx i = map->size++;
+	map->data[i].key = key;
+	map->data[i].value = value;
+}
+
+SNOW_FUNC(weak_ref_new) {
+	REQUIRE_ARGS(1);
+	return snow_create_weak_ref(ARGS[0]);
+}
+
+SNOW_FUNC(weak_ref_value) {
+	ASSERT_TYPE(SELF, SN_WEAK_REF_TYPE);
+	return snow_weak_ref_get((SnWeakRef*)SELF);
+}
+
+void init_weak_ref_class(SnClass* klass)
+{
+	snow_define_class_method(klass, "__call__", weak_ref_new);
+	
+	snow_define_property(klass, "value", weak_ref_value, NULL);
+}
+
+SNOW_FUNC(weak_map_new) {
+	return snow_create_weak_map();
+}
+
+SNOW_FUNC(weak_map_keys) {
+	ASSERT_TYPE(SELF, SN_WEAK_MAP_TYPE);
+	SnWeakMap* self = (SnWeakMap*)SELF;
+	SnArray* keys = snow_create_array_with_size(self->size);
+	for (uintx i = 0; i < self->size; ++i) {
+		snow_array_push(keys, self->data[i].key);
+	}
+	return keys;
+}
+
+SNOW_FUNC(weak_map_values) {
+	ASSERT_TYPE(SELF, SN_WEAK_MAP_TYPE);
+	SnWeakMap* self = (SnWeakMap*)SELF;
+	SnArray* values = snow_create_array_with_size(self->size);
+	for (uintx i = 0; i < self->size; ++i) {
+		snow_array_push(values, self->data[i].value);
+	}
+	return values;
+}
+
+SNOW_FUNC(weak_map_size) {
+	ASSERT_TYPE(SELF, SN_WEAK_MAP_TYPE);
+	return int_to_value(snow_weak_map_size((SnWeakMap*)SELF));
+}
+
+SNOW_FUNC(weak_map_get) {
+	REQUIRE_ARGS(1);
+	ASSERT_TYPE(SELF, SN_WEAK_MAP_TYPE);
+	return snow_weak_map_get(SELF, ARGS[0]);
+}
+
+SNOW_FUNC(weak_map_set) {
+	REQUIRE_ARGS(2);
+	ASSERT_TYPE(SELF, SN_WEAK_MAP_TYPE);
+	snow_weak_map_set(SELF, ARGS[0], ARGS[1]);
+	return ARGS[1];
+}
+
+void init_weak_map_class(SnClass* klass)
+{
+	snow_define_class_method(klass, "__call__", weak_map_new);
+	
+	snow_define_property(klass, "keys", weak_map_keys, NULL);
+	snow_define_property(klass, "values", weak_map_values, NULL);
+	snow_define_property(klass, "size", weak_map_size, NULL);
+	
+	snow_define_method(klass, "[]", weak_map_get);
+	snow_define_method(klass, "[]:", weak_map_set);
+}
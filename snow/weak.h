@@ -0,0 +1,43 @@
+#ifndef WEAK_H_K3PZ7QWM
+#define WEAK_H_K3PZ7QWM
+
+#include "snow/basic.h"
+#include "snow/object.h"
+#include "snow/map.h"
+
+/*
+	Weak references don't keep what they refer to alive. Once the GC finds the target of a WeakRef
+	unreachable, the reference is cleared to NULL. A WeakMap is a map of ephemerons: each value is
+	kept alive only as long as its key is reachable from somewhere other than the map, and entries
+	whose keys have been collected disappear from the map.
+*/
+
+typedef struct SnWeakRef {
+	SnObjectBase base;
+	VALUE target; // cleared by the GC
+} SnWeakRef;
+
+typedef struct SnWeakMapEntry {
+	VALUE key, value;
+} SnWeakMapEntry;
+
+typedef struct SnWeakMap {
+	SnObjectBase base;
+	uintx size;
+	SnWeakMapEntry* data; // an atomic allocation; the entries are not references to the GC
+	SnMapCompare compare;
+	uintx capacity; // entries that fit in data
+} SnWeakMap;
+
+CAPI SnWeakRef* snow_create_weak_ref(VALUE target);
+static inline VALUE snow_weak_ref_get(SnWeakRef* ref) { return ref->target; }
+
+CAPI SnWeakMap* snow_create_weak_map();
+CAPI SnWeakMap* snow_create_weak_map_with_compare(SnMapCompare);
+CAPI bool snow_weak_map_contains(SnWeakMap*, VALUE key);
+CAPI VALUE snow_weak_map_get(SnWeakMap*, VALUE key);
+CAPI void snow_weak_map_set(SnWeakMap*, VALUE key, VALUE val);
+
+static inline uintx snow_weak_map_size(SnWeakMap* map) { return map->size; }
+
+#endif /* end of include guard: WEAK_H_K3PZ7QWM */
@@ -0,0 +1,58 @@
+/*
+	allocbench: Measures small allocations per second per thread as the number of allocating
+	threads rises.
+	
+	Usage: allocbench [max threads] [allocations per thread, in thousands]
+	
+	Each thread is one element of a snow_parallel_for_each, and its rate is measured over its own
+	running time. With the serial task backend the "threads" run one after another, so only the
+	rate per thread is meaningful there, and it should stay flat.
+	This is not run by the test runner.
+*/
+
+#include "snow/intern.h"
+#include "snow/snow.h"
+#include "snow/gc.h"
+#include "snow/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void allocate_garbage(void* data, size_t element_size, size_t index, void* userdata) {
+	uintx num_allocations = *(uintx*)userdata;
+	double start = now_ms();
+	for (uintx i = 0; i < num_allocations; ++i) {
+		// mostly small, like contexts, argument lists and strings
+		snow_gc_alloc_blob(16 + (i % 4) * 16);
+	}
+	((double*)data)[index] = now_ms() - start;
+}
+
+int main(int argc, char const *argv[])
+{
+	uintx max_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+	uintx num_allocations = (argc > 2 ? strtoul(argv[2], NULL, 10) : 1000) * 1000;
+	
+	snow_init();
+	
+	printf("%8s %16s %20s\n", "threads", "total (M/s)", "per thread (M/s)");
+	for (uintx num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		double thread_ms[num_threads];
+		double start = now_ms();
+		snow_parallel_for_each(thread_ms, sizeof(double), num_threads, allocate_garbage, &num_allocations);
+		double total = (double)num_threads * num_allocations / (now_ms() - start) / 1e3;
+		double per_thread = 0.0;
+		for (uintx i = 0; i < num_threads; ++i) {
+			per_thread += num_allocations / thread_ms[i] / 1e3;
+		}
+		printf("%8lu %16.2f %20.2f\n", (unsigned long)num_threads, total, per_thread / num_threads);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -41,6 +41,63 @@ TEST_CASE(simple_closure) {
 	TEST(value_to_int(ret) == 579);
 }
 
+TEST_CASE(loop_polls_safepoint) {
+	// with the poll word set, every iteration stops at a GC barrier, and must come back unharmed
+	SnAstNode* def = snow_ast_function("<no name>", "<no file>", snow_ast_sequence(0),
+		snow_ast_sequence(3,
+			snow_ast_local_assign(snow_symbol("a"), snow_ast_literal(int_to_value(0))),
+			snow_ast_loop(
+				snow_ast_call(snow_ast_member(snow_ast_local(snow_symbol("a")), snow_symbol("<")), snow_ast_sequence(1, snow_ast_literal(int_to_value(1000)))),
+				snow_ast_local_assign(snow_symbol("a"), snow_ast_call(snow_ast_member(snow_ast_local(snow_symbol("a")), snow_symbol("+")), snow_ast_sequence(1, snow_ast_literal(int_to_value(1)))))
+			),
+			snow_ast_local(snow_symbol("a"))
+		)
+	);
+	SnFunction* f = snow_codegen_compile(snow_create_codegen(def, NULL));
+	_snow_gc_safepoint_requested = 1;
+	VALUE ret = snow_call(NULL, f, 0);
+	_snow_gc_safepoint_requested = 0;
+	TEST(is_integer(ret));
+	TEST(value_to_int(ret) == 1000);
+}
+
+static uintx made_address = 0; // not a VALUE, so the test itself doesn't keep the object in place
+
+SNOW_FUNC(keep) {
+	return SELF;
+}
+
+SNOW_FUNC(make) {
+	SnObject* obj = snow_create_object(NULL);
+	snow_set_member(obj, snow_symbol("keep"), snow_create_function(keep));
+	snow_set_member(obj, snow_symbol("value"), int_to_value(123));
+	made_address = (uintx)obj;
+	return obj;
+}
+
+SNOW_FUNC(collect) {
+	snow_gc();
+	return SN_NIL;
+}
+
+TEST_CASE(temporaries_are_moved) {
+	// make().keep(collect()): while collect() runs, the new object is only in a temporary, which the
+	// stack map of the call site marks as live, so it is moved and the temporary updated, not pinned
+	snow_set_global(snow_symbol("make"), snow_create_function(make));
+	snow_set_global(snow_symbol("collect"), snow_create_function(collect));
+	SnAstNode* def = snow_ast_function("<no name>", "<no file>", snow_ast_sequence(0),
+		snow_ast_sequence(1,
+			snow_ast_call(snow_ast_member(snow_ast_call(snow_ast_local(snow_symbol("make")), snow_ast_sequence(0)), snow_symbol("keep")),
+				snow_ast_sequence(1, snow_ast_call(snow_ast_local(snow_symbol("collect")), snow_ast_sequence(0))))
+		)
+	);
+	SnFunction* f = snow_codegen_compile(snow_create_codegen(def, NULL));
+	VALUE ret = snow_call(NULL, f, 0);
+	TEST(is_object(ret));
+	TEST((uintx)ret != made_address);
+	TEST_EQ(snow_get_member(ret, snow_symbol("value")), int_to_value(123));
+}
+
 /*TEST_CASE(object_get) {
 	HandleScope _;
 	RefPtr<FunctionDefinition> def = _function(
@@ -0,0 +1,471 @@
+#include "test/test.h"
+#include "snow/intern.h"
+#include "snow/gc.h"
+#include "snow/array.h"
+#include "snow/str.h"
+#include "snow/weak.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+TEST_CASE(interior_pointers) {
+	byte* blob = (byte*)snow_gc_alloc_atomic(3000);
+	uintx size = snow_gc_allocated_size(blob);
+	TEST(size >= 3000);
+	TEST_EQ(snow_gc_allocated_size(blob + 1), size);
+	TEST_EQ(snow_gc_allocated_size(blob + 1500), size);
+	TEST_EQ(snow_gc_allocated_size(blob + 2999), size);
+
+	byte* small = (byte*)snow_gc_alloc_atomic(16);
+	TEST(snow_gc_allocated_size(small) >= 16);
+	TEST_EQ(snow_gc_allocated_size(small + 15), snow_gc_allocated_size(small));
+}
+
+TEST_CASE(realloc_keeps_contents) {
+	// the most recent allocation grows in place, any other one moves
+	byte* blob = (byte*)snow_gc_alloc_atomic(64);
+	for (int i = 0; i < 64; ++i) blob[i] = i;
+	byte* grown = (byte*)snow_gc_realloc(blob, 128);
+	TEST(grown == blob);
+	TEST(snow_gc_allocated_size(grown) >= 128);
+	
+	snow_gc_alloc_atomic(16);
+	byte* moved = (byte*)snow_gc_realloc(grown, 256);
+	TEST(moved != grown);
+	TEST(snow_gc_allocated_size(moved) >= 256);
+	bool intact = true;
+	for (int i = 0; i < 64; ++i) intact = intact && moved[i] == i;
+	TEST(intact);
+}
+
+static SnArray* create_test_array(intx n) {
+	SnArray* array = snow_create_array_with_size(n);
+	for (intx i = 0; i < n; ++i) {
+		snow_array_push(array, snow_create_string("snow"));
+	}
+	return array;
+}
+
+static bool check_test_array(SnArray* array, intx n) {
+	if (snow_array_size(array) != n) return false;
+	for (intx i = 0; i < n; ++i) {
+		SnString* str = (SnString*)snow_array_get(array, i);
+		if (snow_typeof(str) != SN_STRING_TYPE) return false;
+		if (strcmp(snow_string_cstr(str), "snow") != 0) return false;
+	}
+	return true;
+}
+
+TEST_CASE(survives_collection) {
+	VALUE key = snow_store_add(create_test_array(100));
+	for (int i = 0; i < 20; ++i) {
+		for (int j = 0; j < 100; ++j) create_test_array(10); // garbage
+		snow_gc();
+		TEST(check_test_array((SnArray*)snow_store_get(key), 100));
+	}
+}
+
+TEST_CASE(deep_graph) {
+	// a long chain of arrays, deep enough to overflow the C stack if marking recursed
+	SnArray* head = snow_create_array_with_size(2);
+	VALUE key = snow_store_add(head);
+	SnArray* current = head;
+	for (int i = 0; i < 200000; ++i) {
+		SnArray* next = snow_create_array_with_size(2);
+		snow_array_push(next, int_to_value(i));
+		snow_array_push(current, next);
+		current = next;
+	}
+	snow_gc();
+	snow_gc();
+	
+	current = (SnArray*)snow_store_get(key);
+	for (int i = 0; i < 200000; ++i) {
+		current = (SnArray*)snow_array_get(current, i == 0 ? 0 : 1);
+		TEST(snow_typeof(current) == SN_ARRAY_TYPE);
+		TEST_EQ(snow_array_get(current, 0), int_to_value(i));
+	}
+}
+
+TEST_CASE(old_references_young) {
+	// once the array has survived a few collections, new elements are only found through its cards
+	VALUE key = snow_store_add(snow_create_array());
+	snow_gc();
+	snow_gc();
+	for (int i = 0; i < 20; ++i) {
+		SnArray* old = (SnArray*)snow_store_get(key);
+		for (int j = 0; j < 50; ++j) {
+			snow_array_push(old, snow_create_string("snow"));
+			create_test_array(10); // garbage
+		}
+		snow_gc();
+		TEST(check_test_array((SnArray*)snow_store_get(key), (i + 1) * 50));
+	}
+}
+
+TEST_CASE(sparse_old_generation) {
+	// leave a few survivors in each old heap, so major collections have to free or move the rest
+	SnArray* array = create_test_array(2000);
+	VALUE key = snow_store_add(array);
+	snow_gc();
+	for (intx i = 0; i < 2000; ++i) {
+		if (i % 10) snow_array_set(array, i, SN_NIL);
+	}
+	for (int i = 0; i < 12; ++i) snow_gc(); // at least one major collection
+	
+	array = (SnArray*)snow_store_get(key);
+	for (intx i = 0; i < 2000; i += 10) {
+		SnString* str = (SnString*)snow_array_get(array, i);
+		TEST(snow_typeof(str) == SN_STRING_TYPE);
+		TEST(strcmp(snow_string_cstr(str), "snow") == 0);
+	}
+}
+
+TEST_CASE(big_objects) {
+	VALUE key = snow_store_add(create_test_array(1000)); // the array data is a big allocation
+	for (int i = 0; i < 20; ++i) {
+		for (int j = 0; j < 50; ++j) {
+			byte* garbage = (byte*)snow_gc_alloc_atomic(0x100000);
+			garbage[0x100000-1] = 1;
+		}
+		snow_gc();
+		TEST(check_test_array((SnArray*)snow_store_get(key), 1000));
+	}
+}
+
+TEST_CASE(pinned_objects) {
+	// a stack reference pins its array in place, and later survivors are promoted into the space around it
+	SnArray* volatile pinned = create_test_array(10);
+	VALUE key = snow_store_add(snow_create_array());
+	for (int i = 0; i < 12; ++i) {
+		for (int j = 0; j < 100; ++j) create_test_array(10); // garbage
+		snow_array_push((SnArray*)snow_store_get(key), create_test_array(10));
+		snow_gc();
+		TEST(check_test_array(pinned, 10));
+	}
+	SnArray* survivors = (SnArray*)snow_store_get(key);
+	for (int i = 0; i < 12; ++i) {
+		TEST(check_test_array((SnArray*)snow_array_get(survivors, i), 10));
+	}
+}
+
+static bool completed_major_since(const SnGCStatistics* before) {
+	// objects of pretenured sites are old from birth, and only die in major collections
+	SnGCStatistics stats;
+	snow_gc_get_stats(&stats);
+	return stats.num_major_collections > before->num_major_collections;
+}
+
+TEST_CASE(weak_references) {
+	// references to unreachable objects are cleared, and those to live ones follow them when they move
+	SnGCStatistics before;
+	snow_gc_get_stats(&before);
+	SnArray* refs = snow_create_array_with_size(300);
+	VALUE key = snow_store_add(refs);
+	for (int i = 0; i < 100; ++i) {
+		SnArray* target = create_test_array(10);
+		snow_array_push(refs, target);
+		snow_array_push(refs, snow_create_weak_ref(target));
+		snow_array_push(refs, snow_create_weak_ref(create_test_array(10)));
+	}
+	for (int i = 0; i < 12 || !completed_major_since(&before); ++i) {
+		for (int j = 0; j < 100; ++j) create_test_array(10); // garbage
+		snow_gc();
+	}
+	
+	refs = (SnArray*)snow_store_get(key);
+	bool intact = true;
+	int num_cleared = 0;
+	for (int i = 0; i < 100; ++i) {
+		SnArray* target = (SnArray*)snow_array_get(refs, 3*i);
+		intact = intact && snow_weak_ref_get((SnWeakRef*)snow_array_get(refs, 3*i+1)) == target && check_test_array(target, 10);
+		if (!snow_weak_ref_get((SnWeakRef*)snow_array_get(refs, 3*i+2))) ++num_cleared;
+	}
+	TEST(intact);
+	TEST(num_cleared > 90);
+}
+
+TEST_CASE(weak_map_ephemerons) {
+	// values are kept only while their keys are reachable from outside the map, even if they reference the keys
+	SnGCStatistics before;
+	snow_gc_get_stats(&before);
+	VALUE keys_key = snow_store_add(snow_create_array_with_size(100));
+	VALUE map_key = snow_store_add(snow_create_weak_map());
+	for (int i = 0; i < 200; ++i) {
+		SnArray* key = create_test_array(10);
+		SnArray* value = snow_create_array_with_size(1);
+		snow_array_push(value, key);
+		snow_weak_map_set((SnWeakMap*)snow_store_get(map_key), key, value);
+		if (i % 2 == 0) snow_array_push((SnArray*)snow_store_get(keys_key), key);
+	}
+	for (int i = 0; i < 12 || !completed_major_since(&before); ++i) {
+		for (int j = 0; j < 100; ++j) create_test_array(10); // garbage
+		snow_gc();
+	}
+	
+	SnWeakMap* map = (SnWeakMap*)snow_store_get(map_key);
+	SnArray* keys = (SnArray*)snow_store_get(keys_key);
+	TEST(snow_weak_map_size(map) >= 100);
+	TEST(snow_weak_map_size(map) < 110);
+	bool intact = true;
+	for (int i = 0; i < 100; ++i) {
+		SnArray* key = (SnArray*)snow_array_get(keys, i);
+		SnArray* value = (SnArray*)snow_weak_map_get(map, key);
+		intact = intact && value && snow_array_get(value, 0) == key && check_test_array(key, 10);
+	}
+	TEST(intact);
+}
+
+static int num_finalized = 0;
+static void count_finalized(VALUE val) { ++num_finalized; }
+
+TEST_CASE(finalized_once) {
+	// old garbage is swept lazily, but each free function must still run exactly once
+	SnArray* array = snow_create_array_with_size(1000);
+	VALUE key = snow_store_add(array);
+	for (int i = 0; i < 1000; ++i) {
+		void* blob = snow_gc_alloc_atomic(48);
+		snow_gc_set_free_func(blob, count_finalized);
+		snow_array_push(array, blob);
+	}
+	snow_gc();
+	array = (SnArray*)snow_store_get(key);
+	for (int i = 0; i < 1000; ++i) snow_array_set(array, i, SN_NIL);
+	// at least two major collections; concurrent ones can take many collections to finish
+	for (int i = 0; i < 250; ++i) snow_gc();
+	TEST(num_finalized > 900);
+	TEST(num_finalized <= 1000);
+}
+
+static int num_realloc_finalized = 0;
+static void count_realloc_finalized(VALUE val) { ++num_realloc_finalized; }
+
+static __attribute__((noinline)) void realloc_finalizable() {
+	byte* blob = (byte*)snow_gc_alloc_atomic(64);
+	snow_gc_set_free_func(blob, count_realloc_finalized);
+	snow_gc_alloc_atomic(16); // so that the realloc moves
+	byte* moved = (byte*)snow_gc_realloc(blob, 256);
+	TEST(moved != blob);
+}
+
+static __attribute__((noinline)) void clear_stack() {
+	// so that nothing left on the stack keeps the blobs alive
+	volatile byte junk[4096];
+	memset((byte*)junk, 0, sizeof(junk));
+}
+
+TEST_CASE(realloc_moves_free_func) {
+	// the free function goes with the copy, or it would run on both the copy and the original
+	realloc_finalizable();
+	clear_stack();
+	for (int i = 0; i < 250; ++i) snow_gc();
+	TEST_EQ(num_realloc_finalized, 1);
+}
+
+static __attribute__((noinline)) SnArray* chain_end(VALUE key) {
+	SnArray* array = (SnArray*)snow_store_get(key);
+	while (snow_array_size(array) == 1) array = (SnArray*)snow_array_get(array, 0);
+	return array;
+}
+
+static __attribute__((noinline)) void move_to_marked(VALUE from_key, VALUE to_key, intx start, intx n) {
+	SnArray* from = chain_end(from_key);
+	SnArray* to = (SnArray*)snow_store_get(to_key);
+	for (intx i = start; i < start + n; ++i) {
+		snow_array_push(to, snow_array_get(from, i));
+		snow_array_set(from, i, SN_NIL);
+	}
+}
+
+TEST_CASE(moved_between_old_objects) {
+	/*
+		Moves old objects from an old array at the end of a long chain to another old array, which
+		marking reaches much sooner. With SNOW_GC_CONCURRENT=1 or SNOW_GC_INCREMENTAL=1 the major
+		cycles mark while this happens, and as no young reference dirties the cards of the target,
+		only the insertion barrier keeps what lands in it alive once it has been marked.
+	*/
+	SnGCStatistics before;
+	snow_gc_get_stats(&before);
+	SnArray* array = snow_create_array_with_size(1);
+	VALUE from_key = snow_store_add(array);
+	for (int i = 0; i < 20000; ++i) {
+		SnArray* next = snow_create_array_with_size(1);
+		snow_array_push(array, next);
+		array = next;
+	}
+	array = NULL;
+	SnArray* from = chain_end(from_key);
+	for (int i = 0; i < 600; ++i) snow_array_push(from, snow_create_string("snow"));
+	from = NULL; // so that nothing on the stack marks the end of the chain early
+	VALUE to_key = snow_store_add(snow_create_array_with_size(600)); // so that it never grows
+	clear_stack();
+	snow_gc();
+	snow_gc();
+	for (int i = 0; i < 150; ++i) {
+		move_to_marked(from_key, to_key, i * 4, 4);
+		for (int j = 0; j < 100; ++j) create_test_array(10); // garbage
+		clear_stack();
+		snow_gc();
+	}
+	TEST(completed_major_since(&before));
+	TEST(check_test_array((SnArray*)snow_store_get(to_key), 600));
+}
+
+static int num_intact = 0;
+static void check_intact(VALUE val) {
+	if (check_test_array(*(SnArray**)val, 10)) ++num_intact;
+}
+
+TEST_CASE(finalizer_sees_references) {
+	// dead objects are kept, along with what they reference, until their free functions have run
+	for (int i = 0; i < 100; ++i) {
+		VALUE* blob = snow_gc_alloc_blob(sizeof(VALUE));
+		blob[0] = create_test_array(10);
+		snow_gc_set_free_func(blob, check_intact);
+	}
+	for (int i = 0; i < 20; ++i) {
+		for (int j = 0; j < 100; ++j) create_test_array(10); // garbage
+		snow_gc();
+	}
+	snow_gc_run_finalizers();
+	TEST(num_intact > 90);
+}
+
+TEST_CASE(statistics) {
+	SnGCStatistics before;
+	snow_gc_get_stats(&before);
+	VALUE key = snow_store_add(create_test_array(100));
+	for (int i = 0; i < 12; ++i) {
+		for (int j = 0; j < 100; ++j) create_test_array(10); // garbage
+		snow_gc();
+	}
+	SnGCStatistics after;
+	snow_gc_get_stats(&after);
+	TEST_EQ(after.num_collections, before.num_collections + 12);
+	TEST(after.num_major_collections <= after.num_collections);
+	TEST(after.bytes_allocated > before.bytes_allocated);
+	TEST(after.bytes_survived < after.bytes_allocated);
+	TEST(after.max_pause_time >= after.last_pause_time);
+	TEST(after.total_pause_time >= after.total_phase_time.mark + after.total_phase_time.sweep + after.total_phase_time.update);
+	TEST(after.max_time_to_safepoint >= after.last_time_to_safepoint);
+	TEST(after.total_pause_time >= after.total_time_to_safepoint);
+	TEST(after.max_slice_time >= after.last_slice_time);
+	TEST(after.total_slice_time >= after.max_slice_time);
+	uint64_t num_pauses = 0;
+	for (int i = 0; i < SNOW_GC_PAUSE_HISTOGRAM_SIZE; ++i) num_pauses += after.pause_histogram[i];
+	TEST_EQ(num_pauses, after.num_collections);
+	TEST(check_test_array((SnArray*)snow_store_get(key), 100));
+}
+
+static __attribute__((noinline)) SnObject* allocate_at_one_site() {
+	SnObject* object = (SnObject*)snow_alloc_any_object(SN_OBJECT_TYPE, sizeof(SnObject));
+	snow_object_init(object, NULL);
+	return object;
+}
+
+static bool is_one_site_pretenured() {
+	SnGCAllocationSite sites[256];
+	uintx n = snow_gc_get_pretenured_sites(sites, 256);
+	for (uintx i = 0; i < n && i < 256; ++i) {
+		const byte* address = (const byte*)sites[i].address;
+		if (address > (const byte*)allocate_at_one_site && address < (const byte*)allocate_at_one_site + 0x100) return true;
+	}
+	return false;
+}
+
+TEST_CASE(pretenuring) {
+	// a site whose objects all survive is pretenured, and demoted once they stop surviving
+	const char* pretenure = getenv("SNOW_GC_PRETENURE");
+	const char* major = getenv("SNOW_GC_MAJOR");
+	if ((pretenure && atoi(pretenure) == 0) || (major && strcmp(major, "copying") == 0)) return;
+	
+	SnArray* kept = snow_create_array_with_size(1000);
+	VALUE key = snow_store_add(kept);
+	for (int i = 0; i < 1000; ++i) {
+		snow_array_push((SnArray*)snow_store_get(key), allocate_at_one_site());
+		if (i % 100 == 99) snow_gc();
+	}
+	TEST(is_one_site_pretenured());
+	
+	SnGCStatistics before, after;
+	snow_gc_get_stats(&before);
+	for (int i = 0; i < 100; ++i) snow_array_push((SnArray*)snow_store_get(key), allocate_at_one_site());
+	snow_gc();
+	snow_gc_get_stats(&after);
+	TEST(after.bytes_pretenured > before.bytes_pretenured);
+	TEST(after.num_pretenured_sites > 0);
+	
+	for (int i = 0; i < 10; ++i) {
+		for (int j = 0; j < 1000; ++j) allocate_at_one_site(); // garbage
+		snow_gc();
+	}
+	TEST(!is_one_site_pretenured());
+	kept = (SnArray*)snow_store_get(key);
+	bool intact = snow_array_size(kept) == 1100;
+	for (intx i = 0; i < snow_array_size(kept); ++i) {
+		intact = intact && ((SnObject*)snow_array_get(kept, i))->base.type == SN_OBJECT_TYPE;
+	}
+	TEST(intact);
+}
+
+TEST_CASE(heap_dump) {
+	SnArray* array = create_test_array(10);
+	snow_store_add(array);
+	char path[] = "/tmp/snow-heap-XXXXXX";
+	close(mkstemp(path));
+	TEST(snow_gc_dump_heap(path));
+	
+	// the stored array is dumped as a root, and as an object that references its data
+	char root[64], object[64];
+	snprintf(root, sizeof(root), " %p\n", (void*)array);
+	snprintf(object, sizeof(object), "object %p Array ", (void*)array);
+	FILE* file = fopen(path, "r");
+	char line[0x1000];
+	TEST(fgets(line, sizeof(line), file) && strcmp(line, "snow-heap 1\n") == 0);
+	bool found_root = false, found_object = false;
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(line, "root store ", 11) == 0 && strstr(line, root)) found_root = true;
+		if (strncmp(line, object, strlen(object)) == 0) found_object = strchr(line + strlen(object), ' ') != NULL;
+	}
+	fclose(file);
+	unlink(path);
+	TEST(found_root);
+	TEST(found_object);
+}
+
+static VALUE sampled_key = NULL;
+static VALUE allocate_samples(SnContext* context) {
+	sampled_key = snow_store_add(snow_create_array());
+	for (int i = 0; i < 1000; ++i) {
+		snow_array_push((SnArray*)snow_store_get(sampled_key), create_test_array(10));
+		create_test_array(10); // garbage
+	}
+	return NULL;
+}
+
+TEST_CASE(allocation_sampling) {
+	snow_gc_set_sample_interval(0x1000);
+	SnFunction* func = snow_create_function_with_name(allocate_samples, "allocate_samples");
+	snow_call(NULL, func, 0);
+	snow_gc();
+	snow_gc_set_sample_interval(0);
+	char path[] = "/tmp/snow-alloc-profile-XXXXXX";
+	close(mkstemp(path));
+	TEST(snow_gc_write_alloc_profile(path));
+	
+	// the arrays kept in the store survived, and those not kept died
+	FILE* file = fopen(path, "r");
+	char line[0x1000];
+	bool found_survived = false, found_died = false;
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(line, "allocate_samples;", 17) != 0) continue;
+		if (strstr(line, " (survived) ")) found_survived = true;
+		if (strstr(line, " (died) ")) found_died = true;
+	}
+	fclose(file);
+	unlink(path);
+	TEST(found_survived);
+	TEST(found_died);
+	TEST_EQ(snow_array_size((SnArray*)snow_store_get(sampled_key)), 1000);
+}
@@ -0,0 +1,94 @@
+/*
+	gcbench: Measures the pause time of minor collections as the old generation grows.
+	
+	Usage: gcbench [max old generation size in MiB] [step in MiB]
+	
+	Run with SNOW_GC_GENERATIONAL=0 to compare against collections that trace the whole heap, and
+	with SNOW_GC_MAJOR=copying to compare the copying old generation with the size class space.
+	This is not run by the test runner.
+*/
+
+#include "snow/intern.h"
+#include "snow/snow.h"
+#include "snow/gc.h"
+#include "snow/array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define OLD_CHUNK_SIZE 1024
+#define CHUNKS_PER_ARRAY 1024
+#define NUM_SAMPLES 11
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void grow_old_generation(SnArray* old, uintx num_bytes) {
+	for (uintx allocated = 0; allocated < num_bytes;) {
+		SnArray* chunks = snow_create_array_with_size(CHUNKS_PER_ARRAY);
+		for (int i = 0; i < CHUNKS_PER_ARRAY; ++i) {
+			snow_array_push(chunks, snow_gc_alloc_blob(OLD_CHUNK_SIZE));
+		}
+		snow_array_push(old, chunks);
+		allocated += CHUNKS_PER_ARRAY * OLD_CHUNK_SIZE;
+	}
+}
+
+static double max_rss_mb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+static void measure_pauses(SnArray* old, double* out_median, double* out_max) {
+	double samples[NUM_SAMPLES];
+	for (int i = 0; i < NUM_SAMPLES; ++i) {
+		// young garbage, and a few young objects referenced from old ones
+		for (int j = 0; j < 10000; ++j) {
+			SnArray* young = snow_create_array_with_size(4);
+			if (j % 100 == 0) {
+				SnArray* chunks = (SnArray*)snow_array_get(old, j % snow_array_size(old));
+				snow_array_set(chunks, 0, young);
+			}
+		}
+		double start = now_ms();
+		snow_gc();
+		samples[i] = now_ms() - start;
+	}
+	// the median hides the occasional major collection, and the maximum shows it
+	qsort(samples, NUM_SAMPLES, sizeof(double), compare_doubles);
+	*out_median = samples[NUM_SAMPLES / 2];
+	*out_max = samples[NUM_SAMPLES - 1];
+}
+
+int main(int argc, char const *argv[])
+{
+	uintx max_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 1024;
+	uintx step_mb = argc > 2 ? strtoul(argv[2], NULL, 10) : 128;
+	
+	snow_init();
+	
+	SnArray* old = snow_create_array();
+	VALUE key = snow_store_add(old);
+	
+	printf("%12s %16s %16s %16s\n", "old (MiB)", "minor pause (ms)", "max pause (ms)", "max RSS (MiB)");
+	for (uintx mb = step_mb; mb <= max_mb; mb += step_mb) {
+		old = (SnArray*)snow_store_get(key);
+		grow_old_generation(old, step_mb * 1024 * 1024);
+		snow_gc(); // promote the new chunks
+		double median, max;
+		measure_pauses((SnArray*)snow_store_get(key), &median, &max);
+		printf("%12lu %16.3f %16.3f %16.1f\n", (unsigned long)mb, median, max, max_rss_mb());
+		fflush(stdout);
+	}
+	return 0;
+}
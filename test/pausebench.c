@@ -0,0 +1,79 @@
+/*
+	pausebench: Measures the distribution of collection pauses in a long-running program, which
+	keeps replacing parts of a large live set.
+	
+	Usage: pausebench [live set in MiB] [collections]
+	
+	Collections are triggered explicitly, often enough that the nursery never fills up, so that
+	every pause is timed. Run with SNOW_GC_CONCURRENT=1 to compare concurrent major collections, and
+	with SNOW_GC_INCREMENTAL=1 (and SNOW_GC_SLICE_BUDGET in microseconds) for incremental ones.
+	This is not run by the test runner.
+*/
+
+#include "snow/intern.h"
+#include "snow/snow.h"
+#include "snow/gc.h"
+#include "snow/array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define SLOTS_PER_ARRAY 1024
+#define ENTRY_SIZE 256
+#define REPLACED_PER_ROUND 1000
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static VALUE create_entry() {
+	VALUE* entry = snow_gc_alloc_blob(ENTRY_SIZE);
+	entry[0] = snow_gc_alloc_atomic(64);
+	return entry;
+}
+
+int main(int argc, char const *argv[])
+{
+	uintx live_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 128;
+	uintx num_rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000;
+	uintx num_arrays = live_mb * 1024 * 1024 / (SLOTS_PER_ARRAY * ENTRY_SIZE);
+	
+	snow_init();
+	
+	VALUE key = snow_store_add(snow_create_array_with_size(num_arrays));
+	for (uintx i = 0; i < num_arrays; ++i) {
+		SnArray* slots = snow_create_array_with_size(SLOTS_PER_ARRAY);
+		snow_array_push((SnArray*)snow_store_get(key), slots);
+		for (int j = 0; j < SLOTS_PER_ARRAY; ++j) {
+			snow_array_push(slots, create_entry());
+			if (j % 1024 == 0) snow_gc();
+		}
+	}
+	
+	double* pauses = (double*)malloc(sizeof(double) * num_rounds);
+	unsigned seed = 1;
+	for (uintx round = 0; round < num_rounds; ++round) {
+		SnArray* live = (SnArray*)snow_store_get(key);
+		for (int i = 0; i < REPLACED_PER_ROUND; ++i) {
+			seed = seed * 1103515245 + 12345;
+			SnArray* slots = (SnArray*)snow_array_get(live, (seed >> 8) % num_arrays);
+			seed = seed * 1103515245 + 12345;
+			snow_array_set(slots, (seed >> 8) % SLOTS_PER_ARRAY, create_entry());
+		}
+		double start = now_ms();
+		snow_gc();
+		pauses[round] = now_ms() - start;
+	}
+	
+	qsort(pauses, num_rounds, sizeof(double), compare_doubles);
+	printf("%12s %12s %12s %12s\n", "live (MiB)", "p50 (ms)", "p99 (ms)", "max (ms)");
+	printf("%12lu %12.3f %12.3f %12.3f\n", (unsigned long)live_mb, pauses[num_rounds / 2], pauses[num_rounds * 99 / 100], pauses[num_rounds - 1]);
+	return 0;
+}
@@ -18,6 +18,11 @@ def blue(str)
   "\x1b[1;36m#{str}#{RESET_COLOR}"
 end
 
+# suites that are run again in the collector modes that are off by default
+VARIANTS = {
+  "gc" => [{"SNOW_GC_CONCURRENT" => "1"}, {"SNOW_GC_INCREMENTAL" => "1"}]
+}
+
 names = ARGV.sort
 
 passed = 0
@@ -28,25 +33,28 @@ names.each do |name|
   next if name == "test"
   next unless File.exist?(name)
   
-  puts blue("#{name.upcase}")
-  command = "./#{name}"
-  system(command)
-  exitcode = $?
-  if exitcode == 0
-    passed += 1
-  elsif exitcode == 2
-    pending += 1
-  else
-    failed += 1
-    likely = nil
-    if exitcode == 5
-      likely = "looks like a failed assert or a debug trap"
-    elsif exitcode == 11
-      likely = "looks like a segfault"
+  [{}].concat(VARIANTS[name] || []).each do |env|
+    settings = env.map { |key, value| "#{key}=#{value}" }.join(" ")
+    puts blue(settings.empty? ? name.upcase : "#{name.upcase} (#{settings})")
+    command = "./#{name}"
+    system(env, command)
+    exitcode = $?
+    if exitcode == 0
+      passed += 1
+    elsif exitcode == 2
+      pending += 1
+    else
+      failed += 1
+      likely = nil
+      if exitcode == 5
+        likely = "looks like a failed assert or a debug trap"
+      elsif exitcode == 11
+        likely = "looks like a segfault"
+      end
+      likely = " (#{likely})" if likely
+      puts "#{red('FAILED')} with exitcode #{exitcode}#{likely}."
     end
-    likely = " (#{likely})" if likely
-    puts "#{red('FAILED')} with exitcode #{exitcode}#{likely}."
+    puts
   end
-  puts
 end
 puts("#{passed} #{passed == 1 ? 'suite' : 'suites'} passed, #{failed} failed, #{pending} pending")
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+	safepointbench: Measures how long collections wait for other threads to stop, while those threads
+	are busy in compiled loops that never allocate, so that they only stop at the safepoint polls
+	in generated code.
+	
+	Usage: safepointbench [busy threads] [collections]
+	
+	The busy threads are deferred calls, so how many of them actually run at once is up to the task
+	implementation; with the serial one, none do, and the numbers are only the overhead.
+	This is not run by the test runner.
+*/
+
+#include "snow/intern.h"
+#include "snow/snow.h"
+#include "snow/gc.h"
+#include "snow/task.h"
+#include "snow/codegen.h"
+#include "snow/function.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define START_TIMEOUT_MS 2000.0
+
+static volatile uintx num_started = 0;
+
+static double now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int compare_uint64s(const void* a, const void* b) {
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+SNOW_FUNC(started) {
+	__sync_add_and_fetch(&num_started, 1);
+	return SN_NIL;
+}
+
+static SnFunction* compile_spinner() {
+	// started(); while spinning { nil }
+	SnAstNode* def = snow_ast_function("spinner", "<safepointbench>", snow_ast_sequence(0),
+		snow_ast_sequence(2,
+			snow_ast_call(snow_ast_local(snow_symbol("started")), snow_ast_sequence(0)),
+			snow_ast_loop(snow_ast_local(snow_symbol("spinning")), snow_ast_literal(SN_NIL))
+		)
+	);
+	return snow_codegen_compile(snow_create_codegen(def, NULL));
+}
+
+int main(int argc, char const *argv[])
+{
+	uintx num_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : 8;
+	uintx num_rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000;
+	
+	snow_init();
+	
+	snow_set_global(snow_symbol("started"), snow_create_function(started));
+	snow_set_global(snow_symbol("spinning"), SN_TRUE);
+	SnFunction* spinner = compile_spinner();
+	VALUE key = snow_store_add(snow_create_array_with_size(num_threads));
+	for (uintx i = 0; i < num_threads; ++i) {
+		snow_array_push((SnArray*)snow_store_get(key), snow_deferred_call(spinner));
+	}
+	double start = now_ms();
+	while (num_started < num_threads && now_ms() - start < START_TIMEOUT_MS) snow_gc_barrier();
+	uintx num_busy = num_started;
+	
+	uint64_t* times = (uint64_t*)malloc(sizeof(uint64_t) * num_rounds);
+	for (uintx round = 0; round < num_rounds; ++round) {
+		snow_gc();
+		SnGCStatistics stats;
+		snow_gc_get_stats(&stats);
+		times[round] = stats.last_time_to_safepoint;
+	}
+	
+	snow_set_global(snow_symbol("spinning"), SN_FALSE);
+	SnArray* tasks = (SnArray*)snow_store_get(key);
+	for (uintx i = 0; i < num_threads; ++i) {
+		snow_deferred_task_wait((SnDeferredTask*)snow_array_get(tasks, i));
+	}
+	
+	qsort(times, num_rounds, sizeof(uint64_t), compare_uint64s);
+	printf("%12s %12s %12s %12s\n", "busy", "p50 (us)", "p99 (us)", "max (us)");
+	printf("%12lu %12lu %12lu %12lu\n", (unsigned long)num_busy, (unsigned long)times[num_rounds / 2], (unsigned long)times[num_rounds * 99 / 100], (unsigned long)times[num_rounds - 1]);
+	return 0;
+}